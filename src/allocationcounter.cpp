@@ -0,0 +1,99 @@
+#include "allocationcounter.h"
+#include <cerrno>
+#include <cstdlib>
+#include <malloc.h>
+
+namespace
+{
+
+    //Plain thread local counter, no constructor so malloc never allocates to initialise it
+    thread_local std::size_t allocations_ {0};
+
+}
+
+namespace PCMDFT
+{
+
+    std::size_t threadAllocations()
+    {
+        return allocations_;
+    }
+
+}
+
+//The executable interposes the C allocator, so operator new, Qt's QArrayData behind QString and QByteArray,
+//the OpenCL runtime and every other library are counted alike. The actual work is left to glibc.
+extern "C"
+{
+
+    void* __libc_malloc (std::size_t size);
+    void* __libc_calloc (std::size_t count, std::size_t size);
+    void* __libc_realloc (void* p, std::size_t size);
+    void* __libc_memalign (std::size_t alignment, std::size_t size);
+    void* __libc_valloc (std::size_t size);
+    void* __libc_pvalloc (std::size_t size);
+    void __libc_free (void* p);
+
+    void* malloc (std::size_t size) noexcept
+    {
+        ++allocations_;
+        return __libc_malloc (size);
+    }
+
+    void* calloc (std::size_t count, std::size_t size) noexcept
+    {
+        ++allocations_;
+        return __libc_calloc (count, size);
+    }
+
+    void* realloc (void* p, std::size_t size) noexcept
+    {
+        ++allocations_;
+        return __libc_realloc (p, size);
+    }
+
+    void* memalign (std::size_t alignment, std::size_t size) noexcept
+    {
+        ++allocations_;
+        return __libc_memalign (alignment, size);
+    }
+
+    void* aligned_alloc (std::size_t alignment, std::size_t size) noexcept
+    {
+        ++allocations_;
+        return __libc_memalign (alignment, size);
+    }
+
+    int posix_memalign (void** p, std::size_t alignment, std::size_t size) noexcept
+    {
+        if (alignment % sizeof (void*) || (alignment & (alignment - 1)))
+            return EINVAL;
+
+        ++allocations_;
+        void* block {__libc_memalign (alignment, size) };
+
+        if (!block)
+            return ENOMEM;
+
+        *p = block;
+        return 0;
+    }
+
+    void* valloc (std::size_t size) noexcept
+    {
+        ++allocations_;
+        return __libc_valloc (size);
+    }
+
+    void* pvalloc (std::size_t size) noexcept
+    {
+        ++allocations_;
+        return __libc_pvalloc (size);
+    }
+
+    void free (void* p) noexcept
+    {
+        __libc_free (p);
+    }
+
+}
@@ -0,0 +1,35 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+#include <atomic>
+#include <cstddef>
+
+namespace PCMDFT
+{
+
+    //Heap allocations made so far by the calling thread, counted by the interposed malloc family
+    std::size_t threadAllocations();
+
+    //Adds the allocations the calling thread makes during the lifetime of the scope to a shared counter,
+    //lets a stage report its own allocations while the GUI thread allocates freely
+    class AllocationScope
+    {
+    public:
+        explicit AllocationScope (std::atomic<std::size_t>& counter) : counter_ (counter), begin_ {threadAllocations() }
+        {}
+
+        ~AllocationScope()
+        {
+            counter_ += threadAllocations() - begin_;
+        }
+
+        //Prevent copying
+        AllocationScope (const AllocationScope&) = delete;
+        AllocationScope& operator= (const AllocationScope&) = delete;
+
+    private:
+        std::atomic<std::size_t>& counter_;
+        std::size_t begin_;
+    };
+
+}
+#endif
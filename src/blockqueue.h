@@ -0,0 +1,136 @@
+#ifndef BLOCK_QUEUE_H
+#define BLOCK_QUEUE_H
+#include <QEvent>
+#include <QSocketNotifier>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "bufferpool.h"
+
+namespace PCMDFT
+{
+
+    //Bounded single-producer, single-consumer FIFO of blocks handed from one stage to the next.
+    //The ring is allocated up front and push() / pop() only move BlockPtr handles, so passing a period
+    //on does not touch the heap, unlike a queued signal which allocates an event per call.
+    //The consumer is woken through an eventfd, watched from its event loop with a QSocketNotifier.
+    class BlockQueue
+    {
+    public:
+        explicit BlockQueue (std::size_t capacity) : ring_ (capacity + 1), head_ {0}, tail_ {0}, dropped_ {0},
+            fd_ {eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC)}
+        {
+            if (fd_ < 0)
+                throw std::runtime_error (std::string {"eventfd: "} + std::strerror (errno));
+        }
+
+        ~BlockQueue()
+        {
+            ::close (fd_);
+        }
+
+        //Producer side, returns false and drops the block when the consumer is capacity blocks behind
+        bool push (BlockPtr spBlock)
+        {
+            std::size_t tail {tail_.load (std::memory_order_relaxed) };
+            std::size_t next {(tail + 1) % ring_.size() };
+
+            if (next == head_.load (std::memory_order_acquire))
+            {
+                ++dropped_;
+                return false;
+            }
+
+            ring_[tail] = std::move (spBlock);
+            tail_.store (next, std::memory_order_release);
+
+            //The block is queued either way, the eventfd counter only saturates near 2^64 pending wake-ups
+            std::uint64_t one {1};
+            ssize_t written {::write (fd_, &one, sizeof (one)) };
+            static_cast<void> (written);
+            return true;
+        }
+
+        //Consumer side, returns false when the queue is empty
+        bool pop (BlockPtr& spBlock)
+        {
+            std::size_t head {head_.load (std::memory_order_relaxed) };
+
+            if (head == tail_.load (std::memory_order_acquire))
+                return false;
+
+            spBlock = std::move (ring_[head]);
+            head_.store ( (head + 1) % ring_.size(), std::memory_order_release);
+            return true;
+        }
+
+        //Call slot on the consumer's thread after pushes. The notifier is a child of the consumer, so it has to
+        //be created before the consumer is moved to its thread and moves along with it. The slot calls
+        //acknowledge() and then drains the queue with pop(). The consumer deletes the notifier on its own
+        //thread before that thread ends.
+        template <typename Consumer>
+        QSocketNotifier* connect (Consumer* consumer, void (Consumer::*slot)())
+        {
+            return new Notifier<Consumer> {fd_, consumer, slot};
+        }
+
+        void acknowledge()
+        {
+            std::uint64_t count;
+
+            while (::read (fd_, &count, sizeof (count)) > 0)
+                ;
+        }
+
+        //Blocks refused by push() because the consumer fell behind
+        std::size_t dropped() const
+        {
+            return dropped_;
+        }
+
+        //Prevent copying
+        BlockQueue (const BlockQueue&) = delete;
+        BlockQueue& operator= (const BlockQueue&) = delete;
+
+    private:
+        //Socket notifier calling the consumer directly from its activation event, which avoids the
+        //overloaded activated() signal whose signature differs between Qt versions
+        template <typename Consumer>
+        class Notifier : public QSocketNotifier
+        {
+        public:
+            Notifier (int fd, Consumer* consumer, void (Consumer::*slot)()) :
+                QSocketNotifier {fd, QSocketNotifier::Read, consumer}, consumer_ {consumer}, slot_ {slot}
+            {}
+
+        protected:
+            bool event (QEvent* event) override
+            {
+                if (event->type() != QEvent::SockAct)
+                    return QSocketNotifier::event (event);
+
+                (consumer_->*slot_)();
+                return true;
+            }
+
+        private:
+            Consumer* consumer_;
+            void (Consumer::*slot_)();
+        };
+
+        std::vector<BlockPtr> ring_;
+        std::atomic<std::size_t> head_, tail_, dropped_;
+        int fd_;
+    };
+
+}
+#endif
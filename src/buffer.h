@@ -5,6 +5,7 @@
 #include <vector>
 #include <cstring>
 #include <cmath>
+#include <memory>
 #include "pcmsettings.h"
 
 namespace PCMDFT
@@ -58,28 +59,41 @@ namespace PCMDFT
     class TSBuffer : public Buffer
     {
     public:
-        TSBuffer (std::shared_ptr<const PCMSettings> spSettings, const QByteArray& bytes) : Buffer{}
+        explicit TSBuffer (std::shared_ptr<const PCMSettings> spSettings) : Buffer{}, spSettings_ {spSettings}
+        {}
+
+        TSBuffer (std::shared_ptr<const PCMSettings> spSettings, const QByteArray& bytes) : TSBuffer {spSettings}
+        {
+            assign (bytes.data(), bytes.length());
+        }
+
+        ~TSBuffer() = default;
+
+        //Deinterleave the frames in bytes, reuses the capacity of previous calls
+        void assign (const char* bytes, std::size_t length)
         {
-            data_.resize (spSettings->channels_);
+            data_.resize (spSettings_->channels_);
 
-            for (int i = 0; i < spSettings->channels_; ++i)
+            for (std::size_t i = 0; i < spSettings_->channels_; ++i)
             {
-                data_[i].reserve (bytes.length() / spSettings->frameSize_);
+                data_[i].clear();
+                data_[i].reserve (length / spSettings_->frameSize_);
             }
 
-            for (int i = 0; i < bytes.length (); i += spSettings->frameSize_)
+            for (std::size_t i = 0; i + spSettings_->frameSize_ <= length; i += spSettings_->frameSize_)
             {
-                for (int j = 0, k = 0; j < spSettings->frameSize_; j += spSettings->sampleSize_, ++k)
+                for (std::size_t j = 0, k = 0; j < spSettings_->frameSize_; j += spSettings_->sampleSize_, ++k)
                 {
                     SampleType s;
-                    std::copy (bytes.data() + i + j, bytes.data() + i + j + sizeof (SampleType), 
+                    std::copy (bytes + i + j, bytes + i + j + sizeof (SampleType), 
                                     reinterpret_cast<char*> (&s));
                     data_[k].push_back (s);
                 }
             }
         }
 
-        ~TSBuffer() = default;
+    private:
+        std::shared_ptr<const PCMSettings> spSettings_;
     };
 
     class FreqBuffer : public Buffer
@@ -95,28 +109,41 @@ namespace PCMDFT
         };
 
     public:
-        FreqBuffer (std::shared_ptr<const PCMSettings> spSettings, const QByteArray& bytes) : Buffer{}
+        explicit FreqBuffer (std::shared_ptr<const PCMSettings> spSettings) : Buffer{}, spSettings_ {spSettings}
+        {}
+
+        FreqBuffer (std::shared_ptr<const PCMSettings> spSettings, const QByteArray& bytes) : FreqBuffer {spSettings}
+        {
+            assign (bytes.data(), bytes.length());
+        }
+
+        ~FreqBuffer() = default;
+
+        //Reduce the complex components to magnitudes, reuses the capacity of previous calls
+        void assign (const char* bytes, std::size_t length)
         {
-            data_.resize (spSettings->channels_);
-            int chnlSz = bytes.length () / spSettings->channels_;
+            data_.resize (spSettings_->channels_);
+            std::size_t chnlSz = length / spSettings_->channels_;
 
-            for (int i = 0; i < spSettings->channels_; ++i)
+            for (std::size_t i = 0; i < spSettings_->channels_; ++i)
             {
-                data_[i].reserve (chnlSz / spSettings->sampleSize_ / 2);
-                int beg = chnlSz * i;
-                int end = beg + chnlSz;
+                data_[i].clear();
+                data_[i].reserve (chnlSz / spSettings_->sampleSize_ / 2);
+                std::size_t beg = chnlSz * i;
+                std::size_t end = beg + chnlSz;
 
-                for (int j = beg; j < end; j += sizeof (CpxNum))
+                for (std::size_t j = beg; j < end; j += sizeof (CpxNum))
                 {
                     CpxNum fc;
-                    std::copy (bytes.data() + j, bytes.data() + j + sizeof (fc), 
+                    std::copy (bytes + j, bytes + j + sizeof (fc), 
                                     reinterpret_cast<char*> (&fc));
                     data_[i].push_back (fc());
                 }
             }
         }
 
-        ~FreqBuffer() = default;
+    private:
+        std::shared_ptr<const PCMSettings> spSettings_;
     };
 
     class DebugHelper
@@ -0,0 +1,172 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace PCMDFT
+{
+
+    //A fixed capacity chunk of memory, size() can shrink and grow without reallocating up to capacity()
+    class Block
+    {
+    public:
+        explicit Block (std::size_t capacity) : data_ (capacity), size_ {0}, channels_ {0}, discontinuity_ {false}
+        {}
+
+        char* data()
+        {
+            return data_.data();
+        }
+
+        const char* data() const
+        {
+            return data_.data();
+        }
+
+        std::size_t size() const
+        {
+            return size_;
+        }
+
+        std::size_t capacity() const
+        {
+            return data_.size();
+        }
+
+        //Returns true if the block had to be reallocated
+        bool resize (std::size_t size)
+        {
+            bool grown {size > data_.size() };
+
+            if (grown)
+                data_.resize (size);
+
+            size_ = size;
+            return grown;
+        }
+
+        //Interleaved channels of the payload, lets later stages skip blocks captured before a reconfiguration
+        void setChannels (std::size_t channels)
+        {
+            channels_ = channels;
+        }
+
+        std::size_t channels() const
+        {
+            return channels_;
+        }
+
+        //The payload does not continue the previous block, e.g. after an xrun or at the start of a triggered
+        //event, stages keeping state across blocks start over
+        void setDiscontinuity (bool discontinuity)
+        {
+            discontinuity_ = discontinuity;
+        }
+
+        bool discontinuity() const
+        {
+            return discontinuity_;
+        }
+
+        //Mark the moment the payload was produced, used to measure latency downstream
+        void stamp()
+        {
+            timestamp_ = std::chrono::steady_clock::now();
+        }
+
+        std::chrono::steady_clock::time_point timestamp() const
+        {
+            return timestamp_;
+        }
+
+        //Prevent copying
+        Block (const Block&) = delete;
+        Block& operator= (const Block&) = delete;
+
+    private:
+        std::vector<char> data_;
+        std::size_t size_, channels_;
+        bool discontinuity_;
+        std::chrono::steady_clock::time_point timestamp_;
+    };
+
+    using BlockPtr = std::shared_ptr<Block>;
+
+    //Preallocated set of blocks handed from stage to stage as BlockPtr. The pool keeps one reference to
+    //every block, a block whose only reference is the pool's own is free and can be handed out again,
+    //so ownership returns to the pool as soon as the last stage drops its pointer.
+    class BlockPool
+    {
+    public:
+        BlockPool (std::size_t blocks, std::size_t blockSize) : next_ {0}, reallocations_ {0}, misses_ {0}
+        {
+            blocks_.reserve (blocks);
+
+            for (std::size_t i = 0; i < blocks; ++i)
+            {
+                blocks_.emplace_back (std::make_shared<Block> (blockSize));
+            }
+        }
+
+        //Returns a block of the given size or an empty pointer when all blocks are in flight
+        BlockPtr acquire (std::size_t size)
+        {
+            std::lock_guard<std::mutex> lock {mutex_};
+
+            for (std::size_t i = 0; i < blocks_.size(); ++i)
+            {
+                BlockPtr& spBlock = blocks_[ (next_ + i) % blocks_.size()];
+
+                if (spBlock.use_count() == 1)
+                {
+                    //Pairs with the release of the last consumer's reference
+                    std::atomic_thread_fence (std::memory_order_acquire);
+                    next_ = (next_ + i + 1) % blocks_.size();
+
+                    if (spBlock->resize (size))
+                        ++reallocations_;
+
+                    return spBlock;
+                }
+            }
+
+            ++misses_;
+            return BlockPtr {};
+        }
+
+        //Blocks that had to grow after construction, stays at zero once the block size has settled.
+        //This covers the pool only, the stages count their own heap allocations with AllocationScope.
+        std::size_t reallocations() const
+        {
+            return reallocations_;
+        }
+
+        //Number of acquire() calls that found no free block
+        std::size_t misses() const
+        {
+            return misses_;
+        }
+
+        std::size_t blocks() const
+        {
+            return blocks_.size();
+        }
+
+        //Prevent copying
+        BlockPool (const BlockPool&) = delete;
+        BlockPool& operator= (const BlockPool&) = delete;
+
+    private:
+        std::mutex mutex_;
+        std::vector<BlockPtr> blocks_;
+        std::size_t next_;
+        std::atomic<std::size_t> reallocations_, misses_;
+    };
+
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef CONSTANT_Q_H
+#define CONSTANT_Q_H
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "pcmsettings.h"
+
+namespace PCMDFT
+{
+
+    //Centre frequencies of the constant-Q bins, cqBinsPerOctave_ per octave from cqMinFreq_ up to the Nyquist frequency
+    inline std::vector<double> constantQCenters (const PCMSettings& settings)
+    {
+        std::vector<double> centers;
+        double nyquist {settings.rate_ / 2.};
+
+        for (std::size_t k = 0; settings.cqBinsPerOctave_ && settings.cqMinFreq_ > 0.; ++k)
+        {
+            double fk {settings.cqMinFreq_ * std::pow (2., static_cast<double> (k) / settings.cqBinsPerOctave_) };
+
+            if (fk >= nyquist)
+                break;
+
+            centers.push_back (fk);
+        }
+
+        return centers;
+    }
+
+    //Sparse spectral kernel mapping the N/2 linear bins of an N point transform onto the constant-Q bins,
+    //in compressed row format: the weights of bin k are weights[rows[k] .. rows[k+1]-1] for the linear
+    //bins cols[...]. Each row is a triangle spanning the neighbouring centres and weights are normalized
+    //so a row yields the mean power in its band.
+    //The resolution is still limited by the linear bin spacing rate/N. Triangles that contain no linear
+    //bin fall back to the nearest one, so at low frequencies several adjacent rows repeat the same single
+    //linear bin, and a linear bin can feed more than two rows (3 at N = 8192 with the defaults, up to 15
+    //at N = 1024). Returns the number of rows made of a single linear bin, a large transform (fftSize_)
+    //reduces them.
+    inline std::size_t constantQKernel (const PCMSettings& settings, std::size_t N,
+                                 std::vector<int>& rows, std::vector<int>& cols, std::vector<SampleType>& weights)
+    {
+        std::vector<double> centers {constantQCenters (settings) };
+        double ratio {std::pow (2., 1. / std::max<std::size_t> (settings.cqBinsPerOctave_, 1)) };
+        double df {static_cast<double> (settings.rate_) / N};
+        int bins = N / 2;
+        std::size_t single {0};
+        rows.assign (1, 0);
+        cols.clear();
+        weights.clear();
+
+        for (double fk : centers)
+        {
+            double lo {fk / ratio}, hi {fk * ratio};
+            int first = std::max (1, static_cast<int> (std::ceil (lo / df)));
+            int last = std::min (bins - 1, static_cast<int> (std::floor (hi / df)));
+            double sum {0.};
+            std::size_t rowBegin {weights.size() };
+
+            for (int j = first; j <= last; ++j)
+            {
+                double f {j * df};
+                double w {f < fk ? (f - lo) / (fk - lo) : (hi - f) / (hi - fk) };
+
+                if (w > 0.)
+                {
+                    cols.push_back (j);
+                    weights.push_back (w);
+                    sum += w;
+                }
+            }
+
+            if (sum > 0.)
+            {
+                for (std::size_t i = rowBegin; i < weights.size(); ++i)
+                {
+                    weights[i] /= sum;
+                }
+            }
+            else
+            {
+                cols.push_back (std::min (bins - 1, std::max (1, static_cast<int> (std::lround (fk / df)))));
+                weights.push_back (1.);
+            }
+
+            if (weights.size() - rowBegin == 1)
+                ++single;
+
+            rows.push_back (cols.size());
+        }
+
+        return single;
+    }
+
+}
+#endif
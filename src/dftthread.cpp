@@ -3,11 +3,16 @@
 #include <fstream>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <chrono>
 #define __CL_ENABLE_EXCEPTIONS
 #include <CL/cl.hpp>
 #include <boost/filesystem.hpp>
 
 #include "buffer.h"
+#include "realtime.h"
+#include "constantq.h"
+#include "allocationcounter.h"
 
 namespace PCMDFT
 {
@@ -16,15 +21,37 @@ struct DFTThread::CLData
     std::unique_ptr<cl::Program> spProgram_;
     std::vector<cl::Platform> platforms_;
     std::vector<cl::Device> devices_;
-    std::unique_ptr<cl::Kernel> spKernel_;
+    std::unique_ptr<cl::Kernel> spKernel_, spCrossKernel_, spConstantQKernel_, spFftColsKernel_, spFftRowsKernel_, spPeakKernel_;
     std::unique_ptr<cl::Context> spContext_;
+    std::unique_ptr<cl::CommandQueue> spQueue_;
+    QString deviceName_;
+    //Device buffers are kept between periods and only reallocated by plan() when the shape changes.
+    //specBuffer_ holds the packed spectra of all channels, the cross-spectral pass reads them in place.
+    cl::Buffer inBuffer_, specBuffer_, pairBuffer_, crossAccBuffer_, crossOutBuffer_,
+               cqRowBuffer_, cqColBuffer_, cqWeightBuffer_, cqOutBuffer_;
+    std::size_t N_ {0}, channels_ {0}, pairs_ {0}, cqBins_ {0}, szLocal_ {0};
+    //Large transforms: per channel ring of the last N samples, the column results and the display bins
+    cl::Buffer accBuffer_, fftTmpBuffer_, peakBuffer_;
+    bool large_ {false};
+    int logN1_ {0};
+    std::size_t fftLocal_ {0}, displayBins_ {0}, writePos_ {0}, filled_ {0}, sinceFft_ {0};
+    //The first frame after planning replaces the cross-spectral averages instead of blending into them
+    bool crossReset_ {true};
+    //Kernel timings are summed up and reported once a second instead of per period
+    std::chrono::steady_clock::time_point statsBegin_ {std::chrono::steady_clock::now()};
+    std::size_t statsFrames_ {0};
+    double statsMs_ {0.}, statsMaxMs_ {0.};
 };
 
-DFTThread::DFTThread (std::shared_ptr<const PCMSettings> spSettings, QObject* parent,
+DFTThread::DFTThread (std::shared_ptr<const PCMSettings> spSettings, std::shared_ptr<BlockQueue> spInput,
+                      std::shared_ptr<BlockPool> spPool, std::shared_ptr<Mailbox<SpectrumFrame>> spMailbox, QObject* parent,
                       std::size_t clPlatId, std::size_t clDeviceId) :
-    QObject {parent}, spThread_ {new QThread}, spSettings_ {spSettings},
-spCLData_ {new CLData}, clPlatId_ {clPlatId}, clDeviceId_ {clDeviceId}
+    QObject {parent}, spThread_ {new QThread}, spSettings_ {spSettings}, spInput_ {spInput}, spPool_ {spPool},
+    spMailbox_ {spMailbox},
+spTSBuf_ {new TSBuffer {spSettings}}, spCLData_ {new CLData}, clPlatId_ {clPlatId}, clDeviceId_ {clDeviceId},
+allocations_ {0}
 {
+    inputNotifier_ = spInput_->connect (this, &DFTThread::slotInputReady);
     this->moveToThread (spThread_.get());
     spThread_->start();
 }
@@ -63,6 +90,12 @@ QStringList DFTThread::getDeviceList (std::size_t platformId)
 
 void DFTThread::init()
 {
+    //init() runs on the DFT thread, so this configures the thread doing the work
+    std::string rtErrors {configureThread ("dft", spSettings_->dftRtPriority_, spSettings_->dftCpu_)};
+
+    if (!rtErrors.empty())
+        emit sigDebug (QString::fromStdString (rtErrors));
+
     boost::filesystem::path clProgramName {boost::filesystem::read_symlink("/proc/self/exe").remove_filename()};
     clProgramName /= spSettings_->clProgramName_;
     std::ifstream programFile {clProgramName.generic_string()};
@@ -80,10 +113,25 @@ void DFTThread::init()
     spCLData_->spProgram_.reset (new cl::Program {*spCLData_->spContext_, source});
     spCLData_->spProgram_->build (spCLData_->devices_);
     spCLData_->spKernel_.reset (new cl::Kernel {*spCLData_->spProgram_, spSettings_->clKernel_.c_str() });
+    spCLData_->spCrossKernel_.reset (new cl::Kernel {*spCLData_->spProgram_, spSettings_->clCrossKernel_.c_str() });
+    spCLData_->spConstantQKernel_.reset (new cl::Kernel {*spCLData_->spProgram_, spSettings_->clConstantQKernel_.c_str() });
+    spCLData_->spFftColsKernel_.reset (new cl::Kernel {*spCLData_->spProgram_, spSettings_->clFftColsKernel_.c_str() });
+    spCLData_->spFftRowsKernel_.reset (new cl::Kernel {*spCLData_->spProgram_, spSettings_->clFftRowsKernel_.c_str() });
+    spCLData_->spPeakKernel_.reset (new cl::Kernel {*spCLData_->spProgram_, spSettings_->clPeakKernel_.c_str() });
+    spCLData_->spQueue_.reset (new cl::CommandQueue {*spCLData_->spContext_, spCLData_->devices_.at (clDeviceId_),
+                                                     CL_QUEUE_PROFILING_ENABLE
+                                                    });
+
+    spCLData_->deviceName_ = QString::fromStdString (spCLData_->devices_.at (clDeviceId_).getInfo<CL_DEVICE_NAME>());
+
+    //Set the local size to the preferred multiple
+    spCLData_->szLocal_ = spCLData_->spKernel_->getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE> (spCLData_->devices_.at (clDeviceId_));
 }
 
 void DFTThread::slotQuit()
 {
+    delete inputNotifier_;
+    inputNotifier_ = nullptr;
     spThread_->quit();
 }
 
@@ -92,7 +140,183 @@ void DFTThread::waitForThread()
     spThread_->wait();
 }
 
-void DFTThread::slotTimeSeriesUpdate (QByteArray bytes)
+std::size_t DFTThread::allocations() const
+{
+    return allocations_;
+}
+
+void DFTThread::slotReconfigure (SettingsPtr spSettings)
+{
+    spSettings_ = spSettings;
+    spTSBuf_.reset (new TSBuffer {spSettings});
+
+    //Re-plan the buffers and sparse kernels with the next period
+    spCLData_->N_ = 0;
+    spCLData_->channels_ = 0;
+    emit sigDebug ("Transform reconfigured");
+}
+
+void DFTThread::plan (std::size_t N, std::size_t channels)
+{
+    if (N == spCLData_->N_ && channels == spCLData_->channels_)
+        return;
+
+    cl::Context& context = *spCLData_->spContext_;
+    cl::Device& device = spCLData_->devices_.at (clDeviceId_);
+    std::size_t szData {N * sizeof (SampleType) };
+    bool large {spSettings_->fftSize_ != 0};
+    spCLData_->specBuffer_ = cl::Buffer {context, CL_MEM_READ_WRITE, szData * channels};
+
+    if (large)
+    {
+        //N = N1 * N2 with N1 >= N2, both sub-transforms have to fit in local memory
+        int logN {0};
+
+        while ( (std::size_t {1} << logN) < N)
+            ++logN;
+
+        if ( (std::size_t {1} << logN) != N || logN < 2 || logN > 22)
+            throw std::runtime_error ("FFT size has to be a power of two between 4 and 4M");
+
+        spCLData_->logN1_ = (logN + 1) / 2;
+        std::size_t N1 {std::size_t {1} << spCLData_->logN1_};
+
+        if (N1 * sizeof (cl_float2) > device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>())
+            throw std::runtime_error ("FFT size too large for the local memory of the device");
+
+        spCLData_->fftLocal_ = std::min ({N1 / 2,
+                                          spCLData_->spFftColsKernel_->getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE> (device),
+                                          spCLData_->spFftRowsKernel_->getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE> (device)
+                                         });
+        spCLData_->displayBins_ = std::max<std::size_t> (1, std::min (spSettings_->fftDisplayBins_, N / 2));
+
+        //The reduction works on whole bins per display bin
+        while ( (N / 2) % spCLData_->displayBins_)
+            --spCLData_->displayBins_;
+
+        spCLData_->accBuffer_ = cl::Buffer {context, CL_MEM_READ_WRITE, szData * channels};
+        spCLData_->fftTmpBuffer_ = cl::Buffer {context, CL_MEM_READ_WRITE, N * sizeof (cl_float2) * channels};
+        spCLData_->peakBuffer_ = cl::Buffer {context, CL_MEM_WRITE_ONLY, 2 * spCLData_->displayBins_ * sizeof (SampleType) * channels};
+        spCLData_->writePos_ = 0;
+        spCLData_->filled_ = 0;
+        spCLData_->sinceFft_ = 0;
+        spCLData_->inBuffer_ = cl::Buffer {};
+    }
+    else
+    {
+        spCLData_->inBuffer_ = cl::Buffer {context, CL_MEM_READ_ONLY, szData * channels};
+        spCLData_->accBuffer_ = cl::Buffer {};
+        spCLData_->fftTmpBuffer_ = cl::Buffer {};
+        spCLData_->peakBuffer_ = cl::Buffer {};
+    }
+
+    //Only pairs of two distinct, existing channels are analyzed
+    std::vector<cl_int2> pairs;
+
+    for (const auto& pair : spSettings_->crossPairs_)
+    {
+        if (!large && pair.first < channels && pair.second < channels && pair.first != pair.second)
+        {
+            cl_int2 p;
+            p.s[0] = pair.first;
+            p.s[1] = pair.second;
+            pairs.push_back (p);
+        }
+    }
+
+    spCLData_->pairs_ = pairs.size();
+
+    if (!pairs.empty())
+    {
+        spCLData_->pairBuffer_ = cl::Buffer {context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                             pairs.size() * sizeof (cl_int2), pairs.data()
+                                            };
+        spCLData_->crossAccBuffer_ = cl::Buffer {context, CL_MEM_READ_WRITE, pairs.size() * N / 2 * sizeof (cl_float4)};
+        spCLData_->crossOutBuffer_ = cl::Buffer {context, CL_MEM_WRITE_ONLY, pairs.size() * 3 * N / 2 * sizeof (SampleType)};
+    }
+
+    //The constant-Q kernel depends on N through the linear bin spacing
+    std::vector<int> cqRows, cqCols;
+    std::vector<SampleType> cqWeights;
+    std::size_t cqSingle {constantQKernel (*spSettings_, N, cqRows, cqCols, cqWeights)};
+    spCLData_->cqBins_ = cqRows.size() - 1;
+
+    if (spCLData_->cqBins_)
+    {
+        spCLData_->cqRowBuffer_ = cl::Buffer {context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                              cqRows.size() * sizeof (int), cqRows.data()
+                                             };
+        spCLData_->cqColBuffer_ = cl::Buffer {context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                              cqCols.size() * sizeof (int), cqCols.data()
+                                             };
+        spCLData_->cqWeightBuffer_ = cl::Buffer {context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                                 cqWeights.size() * sizeof (SampleType), cqWeights.data()
+                                                };
+        spCLData_->cqOutBuffer_ = cl::Buffer {context, CL_MEM_WRITE_ONLY, spCLData_->cqBins_ * channels * sizeof (SampleType)};
+    }
+
+    spCLData_->N_ = N;
+    spCLData_->channels_ = channels;
+    spCLData_->large_ = large;
+    spCLData_->crossReset_ = true;
+
+    DebugHelper dbgHelper;
+    dbgHelper << "Planned N: " << N << (large ? " (four-step)" : " (rdft)") << " channels: " << channels <<
+              " cross pairs: " << pairs.size() << " constant-Q bins: " << spCLData_->cqBins_ <<
+              " kernel entries: " << cqCols.size() <<
+              " single linear bin rows: " << cqSingle << " local size: " << (large ? spCLData_->fftLocal_ : spCLData_->szLocal_);
+    emit sigDebug (dbgHelper.string());
+}
+
+bool DFTThread::accumulate (const TSBuffer& buf)
+{
+    cl::CommandQueue& queue = *spCLData_->spQueue_;
+    std::size_t N {spCLData_->N_};
+    std::size_t frames {buf.size (0) };
+
+    //Only the newest N frames of an oversized period matter
+    std::size_t skip {frames > N ? frames - N : 0};
+
+    for (std::size_t i = 0; i < buf.size1(); ++i)
+    {
+        std::size_t pos {spCLData_->writePos_};
+
+        for (std::size_t done = skip; done < frames;)
+        {
+            std::size_t chunk {std::min (frames - done, N - pos) };
+            queue.enqueueWriteBuffer (spCLData_->accBuffer_, CL_TRUE, (i * N + pos) * sizeof (SampleType),
+                                      chunk * sizeof (SampleType), &buf.at (i, done));
+            done += chunk;
+            pos = (pos + chunk) % N;
+        }
+    }
+
+    spCLData_->writePos_ = (spCLData_->writePos_ + frames - skip) % N;
+    spCLData_->filled_ = std::min (N, spCLData_->filled_ + frames);
+    spCLData_->sinceFft_ += frames;
+
+    std::size_t hop {spSettings_->fftHop_ ? spSettings_->fftHop_ : N};
+
+    if (spCLData_->filled_ < N || spCLData_->sinceFft_ < hop)
+        return false;
+
+    spCLData_->sinceFft_ = 0;
+    return true;
+}
+
+void DFTThread::slotInputReady()
+{
+    AllocationScope allocationScope {allocations_};
+    spInput_->acknowledge();
+    BlockPtr spTsBlock;
+
+    while (spInput_->pop (spTsBlock))
+    {
+        process (std::move (spTsBlock));
+    }
+}
+
+void DFTThread::process (BlockPtr spTsBlock)
 {
     try
     {
@@ -101,78 +325,208 @@ void DFTThread::slotTimeSeriesUpdate (QByteArray bytes)
             init();
         }
 
-        TSBuffer buf {spSettings_, bytes};
-        QByteArray freqData;
+        //Periods captured before a channel count change are dropped
+        if (spTsBlock->channels() != spSettings_->channels_)
+            return;
+
+        TSBuffer& buf = *spTSBuf_;
+        buf.assign (spTsBlock->data(), spTsBlock->size());
+
+        if (!buf.size1() || !buf.size (0))
+            return;
+
+        //Get the data size, the transform size is independent of the period size for large transforms
+        int N {static_cast<int> (spSettings_->fftSize_ ? spSettings_->fftSize_ : buf.size (0))};
+        std::size_t channels {buf.size1() };
+
+        //Get the size in bytes
+        std::size_t szData {N * sizeof (SampleType) };
+
+        plan (N, channels);
 
-        for (std::size_t i = 0; i < buf.size1(); ++i)
+        //Gapped input, e.g. a new triggered event, must not be joined to the old ring or averages
+        if (spTsBlock->discontinuity())
         {
-            //Set the local size to the preferred multiple
-            std::size_t szLocal
-            {
-                spCLData_->spKernel_->getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE> (spCLData_->devices_.at (clDeviceId_))
-            };
+            spCLData_->writePos_ = 0;
+            spCLData_->filled_ = 0;
+            spCLData_->sinceFft_ = 0;
+            spCLData_->crossReset_ = true;
+        }
 
-            //Make sure the global size is a multiple of the local size
-            std::size_t szGlobal {std::ceil ( (buf.size (i) / 2. + 1.) / szLocal)* szLocal};
+        //Large transforms wait until enough periods are in the ring
+        if (spCLData_->large_ && !accumulate (buf))
+            return;
 
-            //Get the data size
-            int N {buf.size (i) };
+        //The spectrum has the same size as the time series or the display bins of a large transform,
+        //drop the period if the GUI holds all blocks
+        std::size_t szFc {spCLData_->large_ ? 2 * spCLData_->displayBins_ * sizeof (SampleType) * channels : szData * channels};
+        BlockPtr spFcBlock {spPool_->acquire (szFc)};
 
-            //Get the size in bytes
-            std::size_t szData {N * sizeof (buf.at (i, 0)) };
+        if (!spFcBlock)
+            return;
 
-            //Populate the input buffer
-            QByteArray clBuf {reinterpret_cast<const char*> (&buf.at (i, 0)), szData};
-            cl::Buffer buffer1 {*spCLData_->spContext_,
-                                CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, clBuf.size(), clBuf.data()
-                               };
+        BlockPtr spXsBlock;
 
-            //Allocate the output buffer
-            QByteArray clOutBuf;
-            clOutBuf.resize (szGlobal * 2 * sizeof (buf.at (i, 0)));
-            cl::Buffer buffer2 {*spCLData_->spContext_,
-                                CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, clOutBuf.size(), clOutBuf.data()
-                               };
+        if (spCLData_->pairs_)
+        {
+            spXsBlock = spPool_->acquire (spCLData_->pairs_ * 3 * N / 2 * sizeof (SampleType));
 
-            //Set the arguments
-            spCLData_->spKernel_->setArg (0, buffer1);
-            spCLData_->spKernel_->setArg (1, buffer2);
-            spCLData_->spKernel_->setArg (2, sizeof (N), &N);
+            if (!spXsBlock)
+                return;
+        }
+
+        BlockPtr spCqBlock;
+
+        if (spCLData_->cqBins_)
+        {
+            spCqBlock = spPool_->acquire (spCLData_->cqBins_ * channels * sizeof (SampleType));
+
+            if (!spCqBlock)
+                return;
+        }
+
+        cl::CommandQueue& queue = *spCLData_->spQueue_;
+        std::size_t szLocal {spCLData_->szLocal_};
+        cl::Event profileEvent, profileEndEvent;
 
-            cl::Event profileEvent;
-            cl::CommandQueue queue {*spCLData_->spContext_, spCLData_->devices_.at (clDeviceId_),
-                                    CL_QUEUE_PROFILING_ENABLE
-                                   };
-            cl::NDRange local_size {szLocal};
-            cl::NDRange global_size {szGlobal};
+        if (spCLData_->large_)
+        {
+            //Columns of the ring starting at the oldest sample, then rows into the packed spectrum
+            std::size_t N1 {std::size_t {1} << spCLData_->logN1_}, N2 {N / N1}, szFftLocal {spCLData_->fftLocal_};
+            int logN1 {spCLData_->logN1_}, start = spCLData_->writePos_;
+            cl::Kernel& cols = *spCLData_->spFftColsKernel_;
+            cols.setArg (0, spCLData_->accBuffer_);
+            cols.setArg (1, spCLData_->fftTmpBuffer_);
+            cols.setArg (2, cl::__local (N1 * sizeof (cl_float2)));
+            cols.setArg (3, sizeof (N), &N);
+            cols.setArg (4, sizeof (logN1), &logN1);
+            cols.setArg (5, sizeof (start), &start);
+            queue.enqueueNDRangeKernel (cols, cl::NullRange, cl::NDRange {N2 * szFftLocal, channels},
+                                        cl::NDRange {szFftLocal, 1}, NULL, &profileEvent);
+
+            cl::Kernel& rows = *spCLData_->spFftRowsKernel_;
+            rows.setArg (0, spCLData_->fftTmpBuffer_);
+            rows.setArg (1, spCLData_->specBuffer_);
+            rows.setArg (2, cl::__local (N2 * sizeof (cl_float2)));
+            rows.setArg (3, sizeof (N), &N);
+            rows.setArg (4, sizeof (logN1), &logN1);
+            queue.enqueueNDRangeKernel (rows, cl::NullRange, cl::NDRange {N1 * szFftLocal, channels},
+                                        cl::NDRange {szFftLocal, 1}, NULL, &profileEndEvent);
+        }
+        else
+        {
+            //Make sure the global size is a multiple of the local size
+            std::size_t szGlobal {static_cast<std::size_t> (std::ceil ( (N / 2. + 1.) / szLocal))* szLocal};
+
+            //Populate the input buffer, one channel after the other
+            for (std::size_t i = 0; i < channels; ++i)
             {
-                DebugHelper dbgHelper;
-                dbgHelper << "global size " << szGlobal << " local size " << szLocal << " N: " << N;
-                emit sigDebug (dbgHelper.string());
+                queue.enqueueWriteBuffer (spCLData_->inBuffer_, CL_FALSE, i * szData, szData, &buf.at (i, 0));
             }
 
-            //Enqueue the kernel and wait
+            //Set the arguments
+            spCLData_->spKernel_->setArg (0, spCLData_->inBuffer_);
+            spCLData_->spKernel_->setArg (1, spCLData_->specBuffer_);
+            spCLData_->spKernel_->setArg (2, sizeof (N), &N);
+
+            cl::NDRange local_size {szLocal, 1};
+            cl::NDRange global_size {szGlobal, channels};
+
+            //All channels in one launch
             queue.enqueueNDRangeKernel (*spCLData_->spKernel_, cl::NullRange, global_size, local_size, NULL, &profileEvent);
-            queue.finish();
+            profileEndEvent = profileEvent;
+        }
 
-            cl_ulong start = profileEvent.getProfilingInfo<CL_PROFILING_COMMAND_START>();
-            cl_ulong end = profileEvent.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+        //Cross spectra straight from the spectra in device memory, only the results are read back
+        if (spXsBlock)
+        {
+            SampleType alpha {static_cast<SampleType> (spSettings_->crossAlpha_) };
+
+            //A new plan or a gap starts the average over, the fresh buffer holds garbage and alpha 1 alone would
+            //keep NaN or Inf from it, so clear it first
+            if (spCLData_->crossReset_)
             {
-                DebugHelper dbgHelper;
-                dbgHelper << "\t\tElapsed time: " << (end - start) / 1000. / 1000. << " ms." << " on " <<
-                          QString::fromStdString (spCLData_->devices_.at (clDeviceId_).getInfo<CL_DEVICE_NAME>());
-                emit sigDebug (dbgHelper.string());
+                cl_float4 zero {};
+                queue.enqueueFillBuffer (spCLData_->crossAccBuffer_, zero, 0, spCLData_->pairs_ * N / 2 * sizeof (cl_float4));
+                alpha = 1.f;
+                spCLData_->crossReset_ = false;
             }
 
-            //Read the data back
-            queue.enqueueReadBuffer (buffer2, CL_TRUE, 0, clOutBuf.size(), clOutBuf.data());
+            spCLData_->spCrossKernel_->setArg (0, spCLData_->specBuffer_);
+            spCLData_->spCrossKernel_->setArg (1, spCLData_->pairBuffer_);
+            spCLData_->spCrossKernel_->setArg (2, spCLData_->crossAccBuffer_);
+            spCLData_->spCrossKernel_->setArg (3, spCLData_->crossOutBuffer_);
+            spCLData_->spCrossKernel_->setArg (4, sizeof (N), &N);
+            spCLData_->spCrossKernel_->setArg (5, sizeof (alpha), &alpha);
+            std::size_t szCrossGlobal {static_cast<std::size_t> (std::ceil ( (N / 2.) / szLocal))* szLocal};
+            queue.enqueueNDRangeKernel (*spCLData_->spCrossKernel_, cl::NullRange,
+                                        cl::NDRange {szCrossGlobal, spCLData_->pairs_}, cl::NDRange {szLocal, 1});
+            queue.enqueueReadBuffer (spCLData_->crossOutBuffer_, CL_FALSE, 0, spXsBlock->size(), spXsBlock->data());
+        }
 
-            //Reduce to the data size, extra data is possible if the data size was not a multiple of the local size
-            clOutBuf.resize (szData);
-            freqData.append (clOutBuf);
+        //Constant-Q bins from the same spectra, linear in N through the sparse kernel
+        if (spCqBlock)
+        {
+            int bins = spCLData_->cqBins_;
+            spCLData_->spConstantQKernel_->setArg (0, spCLData_->specBuffer_);
+            spCLData_->spConstantQKernel_->setArg (1, spCLData_->cqRowBuffer_);
+            spCLData_->spConstantQKernel_->setArg (2, spCLData_->cqColBuffer_);
+            spCLData_->spConstantQKernel_->setArg (3, spCLData_->cqWeightBuffer_);
+            spCLData_->spConstantQKernel_->setArg (4, spCLData_->cqOutBuffer_);
+            spCLData_->spConstantQKernel_->setArg (5, sizeof (N), &N);
+            spCLData_->spConstantQKernel_->setArg (6, sizeof (bins), &bins);
+            std::size_t szCqGlobal {static_cast<std::size_t> (std::ceil (static_cast<double> (bins) / szLocal))* szLocal};
+            queue.enqueueNDRangeKernel (*spCLData_->spConstantQKernel_, cl::NullRange,
+                                        cl::NDRange {szCqGlobal, channels}, cl::NDRange {szLocal, 1});
+            queue.enqueueReadBuffer (spCLData_->cqOutBuffer_, CL_FALSE, 0, spCqBlock->size(), spCqBlock->data());
+        }
+
+        if (spCLData_->large_)
+        {
+            //Large spectra are reduced to the display bins on the device, only those are read back
+            int bins = spCLData_->displayBins_;
+            spCLData_->spPeakKernel_->setArg (0, spCLData_->specBuffer_);
+            spCLData_->spPeakKernel_->setArg (1, spCLData_->peakBuffer_);
+            spCLData_->spPeakKernel_->setArg (2, sizeof (N), &N);
+            spCLData_->spPeakKernel_->setArg (3, sizeof (bins), &bins);
+            std::size_t szPeakGlobal {static_cast<std::size_t> (std::ceil (static_cast<double> (bins) / szLocal))* szLocal};
+            queue.enqueueNDRangeKernel (*spCLData_->spPeakKernel_, cl::NullRange,
+                                        cl::NDRange {szPeakGlobal, channels}, cl::NDRange {szLocal, 1});
+            queue.enqueueReadBuffer (spCLData_->peakBuffer_, CL_FALSE, 0, szFc, spFcBlock->data());
         }
+        else
+        {
+            //Read the spectra back straight into the spectrum block
+            queue.enqueueReadBuffer (spCLData_->specBuffer_, CL_FALSE, 0, szFc, spFcBlock->data());
+        }
+
+        queue.finish();
 
-        emit sigFreqCompReady (bytes, freqData);
+        cl_ulong start = profileEvent.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+        cl_ulong end = profileEndEvent.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+        double elapsedMs {(end - start) / 1000. / 1000.};
+        ++spCLData_->statsFrames_;
+        spCLData_->statsMs_ += elapsedMs;
+        spCLData_->statsMaxMs_ = std::max (spCLData_->statsMaxMs_, elapsedMs);
+        std::chrono::steady_clock::time_point now {std::chrono::steady_clock::now()};
+
+        if (now - spCLData_->statsBegin_ >= std::chrono::seconds (1))
+        {
+            DebugHelper dbgHelper;
+            dbgHelper << "\t\t" << spCLData_->statsFrames_ << " transforms, elapsed time: " <<
+                      spCLData_->statsMs_ / spCLData_->statsFrames_ << " ms mean, " << spCLData_->statsMaxMs_ <<
+                      " ms max on " << spCLData_->deviceName_;
+            emit sigDebug (dbgHelper.string());
+            spCLData_->statsBegin_ = now;
+            spCLData_->statsFrames_ = 0;
+            spCLData_->statsMs_ = 0.;
+            spCLData_->statsMaxMs_ = 0.;
+        }
+
+        spFcBlock->resize (szFc);
+
+        //The GUI picks up the newest frame at its own rate
+        spMailbox_->post (SpectrumFrame {spTsBlock, spFcBlock, spXsBlock, spCqBlock});
     }
     catch
         (const std::exception& e)
@@ -182,4 +536,3 @@ void DFTThread::slotTimeSeriesUpdate (QByteArray bytes)
 }
 
 }
-
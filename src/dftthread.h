@@ -4,19 +4,25 @@
 #include <QThread>
 #include <QStringList>
 
+#include <atomic>
 #include <memory>
 
+#include "bufferpool.h"
+#include "blockqueue.h"
+#include "mailbox.h"
+#include "pcmsettings.h"
 
 namespace PCMDFT
 {
 
-class PCMSettings;
+class TSBuffer;
 
 class DFTThread : public QObject
 {
     Q_OBJECT
 public:
-    DFTThread (std::shared_ptr<const PCMSettings> spSettings, QObject* parent = 0,
+    DFTThread (std::shared_ptr<const PCMSettings> spSettings, std::shared_ptr<BlockQueue> spInput,
+                std::shared_ptr<BlockPool> spPool, std::shared_ptr<Mailbox<SpectrumFrame>> spMailbox, QObject* parent = 0,
                 std::size_t clPlatId = 0, std::size_t clDeviceId = 0);
     ~DFTThread();
 
@@ -24,26 +30,41 @@ public:
     static QStringList getDeviceList (std::size_t platformId);
 
     void waitForThread();
+    //Heap allocations made while processing periods since start
+    std::size_t allocations() const;
 
 public slots:
     void slotQuit();
-    void slotTimeSeriesUpdate (QByteArray bytes);
+    //Drains the input queue, called from the queue's notifier
+    void slotInputReady();
+    //Switch to new transform settings, the context, program and kernels are kept
+    void slotReconfigure (SettingsPtr spSettings);
 
 signals:
-    void sigFreqCompReady (QByteArray tsBytes, QByteArray fcBytes);
     void sigError (QString value);
     void sigDebug (QString value);
 
 private:
     void init();
+    void process (BlockPtr spTsBlock);
+    void plan (std::size_t N, std::size_t channels);
+    bool accumulate (const TSBuffer& buf);
     std::unique_ptr<QThread> spThread_;
     std::shared_ptr<const PCMSettings> spSettings_;
+    std::shared_ptr<BlockQueue> spInput_;
+    QSocketNotifier* inputNotifier_;
+    std::shared_ptr<BlockPool> spPool_;
+    std::shared_ptr<Mailbox<SpectrumFrame>> spMailbox_;
+    std::unique_ptr<TSBuffer> spTSBuf_;
     struct CLData;
     std::unique_ptr<CLData> spCLData_;
     std::size_t clPlatId_, clDeviceId_;
+    std::atomic<std::size_t> allocations_;
 };
 
 }
 
 
+Q_DECLARE_METATYPE (PCMDFT::SettingsPtr)
+
 #endif
@@ -0,0 +1,87 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <atomic>
+#include <mutex>
+#include <utility>
+
+#include "bufferpool.h"
+
+namespace PCMDFT
+{
+
+    //Time series together with its spectrum, the cross-spectral results (|Sxy|, coherence and
+    //phase per channel pair, empty without pairs) and the constant-Q magnitudes per channel,
+    //the unit handed from the DFT thread to the GUI
+    struct SpectrumFrame
+    {
+        BlockPtr spTs_, spFc_, spXs_, spCq_;
+    };
+
+    //Single slot, latest-wins hand-off between a producer and a consumer running at different rates.
+    //Posting over an unread value replaces it, the replaced value is released right away.
+    template <typename T>
+    class Mailbox
+    {
+    public:
+        Mailbox() : full_ {false}, posted_ {0}, overwritten_ {0}
+        {}
+
+        //Returns true if an unread value was replaced
+        bool post (T value)
+        {
+            T old;
+            bool replaced;
+            {
+                std::lock_guard<std::mutex> lock {mutex_};
+                replaced = full_;
+                std::swap (old, value_);
+                value_ = std::move (value);
+                full_ = true;
+            }
+            ++posted_;
+
+            if (replaced)
+                ++overwritten_;
+
+            return replaced;
+        }
+
+        //Returns false if nothing was posted since the last take
+        bool take (T& value)
+        {
+            std::lock_guard<std::mutex> lock {mutex_};
+
+            if (!full_)
+                return false;
+
+            value = std::move (value_);
+            value_ = T {};
+            full_ = false;
+            return true;
+        }
+
+        std::size_t posted() const
+        {
+            return posted_;
+        }
+
+        //Values that were never taken because a newer one arrived first
+        std::size_t overwritten() const
+        {
+            return overwritten_;
+        }
+
+        //Prevent copying
+        Mailbox (const Mailbox&) = delete;
+        Mailbox& operator= (const Mailbox&) = delete;
+
+    private:
+        std::mutex mutex_;
+        T value_;
+        bool full_;
+        std::atomic<std::size_t> posted_, overwritten_;
+    };
+
+}
+#endif
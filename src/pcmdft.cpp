@@ -9,29 +9,51 @@
 #include <QAction>
 #include <QMenuBar>
 #include <QPushButton>
+#include <QDateTime>
+#include <QStatusBar>
 #include <qwt_plot_curve.h>
 #include <qwt_series_data.h>
+#include <qwt_scale_engine.h>
 
 #include <iostream>
+#include <algorithm>
 
 #include "pcmthread.h"
 #include "dftthread.h"
+#include "triggerthread.h"
 #include "buffer.h"
 #include "pcmsettings.h"
+#include "seriesdata.h"
+#include "constantq.h"
+#include "settingsstore.h"
+#include "settingsdialog.h"
 #include "ui_pcmdftwindow.h"
 
 namespace PCMDFT
 {
 
-    pcmdft::pcmdft() : spWindow_ {new Ui::MainWindow}, spSettings_ {new PCMSettings}
+    namespace
     {
+
+        //Defaults overridden by the per-user config file
+        SettingsPtr loadedSettings()
+        {
+            PCMSettings settings;
+            loadSettings (settings);
+            return std::make_shared<const PCMSettings> (settings);
+        }
+
+    }
+
+    pcmdft::pcmdft() : spWindow_ {new Ui::MainWindow}, spSettings_ {loadedSettings()},
+        lTs_ {new SeriesData}, rTs_ {new SeriesData}, lFc_ {new SeriesData}, rFc_ {new SeriesData},
+        spTSBuf_ {new TSBuffer {spSettings_}}, spFcBuf_ {new FreqBuffer {spSettings_}}, statsPosted_ {0}
+    {
+        qRegisterMetaType<SettingsPtr>();
         spWindow_->setupUi (this);
-        spWindow_->tsPlotL->setAutoReplot ();
-        spWindow_->tsPlotR->setAutoReplot ();
+        //No autoreplot, the plots are repainted by slotRender at most maxFps_ times a second
         spWindow_->tsPlotL->setAutoDelete (true);
         spWindow_->tsPlotR->setAutoDelete (true);
-        spWindow_->fcPlotL->setAutoReplot ();
-        spWindow_->fcPlotR->setAutoReplot ();
         spWindow_->fcPlotL->setAutoDelete (true);
         spWindow_->fcPlotR->setAutoDelete (true);
 
@@ -43,7 +65,19 @@ namespace PCMDFT
         spRCurve_->attach (spWindow_->tsPlotR);
         spLFcCurve_->attach (spWindow_->fcPlotL);
         spRFcCurve_->attach (spWindow_->fcPlotR);
+        spLCurve_->setData (lTs_);
+        spRCurve_->setData (rTs_);
+        spLFcCurve_->setData (lFc_);
+        spRFcCurve_->setData (rFc_);
 
+        spTimer_.reset (new QTimer);
+        spTimer_->setInterval (1000 / std::max<std::size_t> (spSettings_->maxFps_, 1));
+        QObject::connect (spTimer_.get(), &QTimer::timeout, this, &pcmdft::slotRender);
+        cqCenters_ = constantQCenters (*spSettings_);
+
+        spWindow_->comboView->insertItems (0, QStringList {tr ("Spectrum"), tr ("Cross spectrum"), tr ("Coherence"),
+                                                    tr ("Constant-Q")
+                                                   });
         spWindow_->comboPlatforms->insertItems (0, DFTThread::getPlatformList());
 
         if (spWindow_->comboPlatforms->count())
@@ -52,8 +86,10 @@ namespace PCMDFT
         }
 
         QObject::connect (spWindow_->comboPlatforms, static_cast<void (QComboBox::*) (int) > (&QComboBox::currentIndexChanged), this, &pcmdft::slotPlatformChanged);
+        QObject::connect (spWindow_->comboView, static_cast<void (QComboBox::*) (int) > (&QComboBox::currentIndexChanged), this, &pcmdft::slotViewChanged);
         QObject::connect (spWindow_->btnStart, &QPushButton::clicked, this, &pcmdft::slotStartClicked);
         QObject::connect (spWindow_->btnStop, &QPushButton::clicked, this, &pcmdft::slotStopClicked);
+        QObject::connect (spWindow_->actionSettings, &QAction::triggered, this, &pcmdft::slotSettingsTriggered);
         QObject::connect (spWindow_->actionQuit, &QAction::triggered, this, &pcmdft::close);
     }
 
@@ -61,18 +97,32 @@ namespace PCMDFT
 
     void pcmdft::stopThreads()
     {
+        spTimer_->stop();
+
         if (spPCMThread_)
         {
-            QObject::disconnect (spPCMThread_.get(), &PCMThread::sigTimeSeriesReady, 0, 0);
             spPCMThread_->quit();
             spPCMThread_->wait();
             spPCMThread_.reset (nullptr);
         }
 
+        //Trigger and DFT thread both quit on sigQuit
+        if (spTriggerThread_)
+            QObject::disconnect (spTriggerThread_.get(), 0, 0, 0);
+
         if (spDFTThread_)
-        {
             QObject::disconnect (spDFTThread_.get(), 0, 0, 0);
-            emit sigQuit();
+
+        emit sigQuit();
+
+        if (spTriggerThread_)
+        {
+            spTriggerThread_->waitForThread();
+            spTriggerThread_.reset (nullptr);
+        }
+
+        if (spDFTThread_)
+        {
             spDFTThread_->waitForThread();
             spDFTThread_.reset (nullptr);
         }
@@ -92,6 +142,67 @@ namespace PCMDFT
         spWindow_->comboDevices->insertItems (0, DFTThread::getDeviceList (platformIdx));
     }
 
+    void pcmdft::slotViewChanged (int view)
+    {
+        //Constant-Q bins are spaced evenly on a log axis
+        for (QwtPlot* plot : {spWindow_->fcPlotL, spWindow_->fcPlotR})
+        {
+            if (view == ViewConstantQ)
+                plot->setAxisScaleEngine (QwtPlot::xBottom, new QwtLogScaleEngine);
+            else
+                plot->setAxisScaleEngine (QwtPlot::xBottom, new QwtLinearScaleEngine);
+        }
+    }
+
+    void pcmdft::slotSettingsTriggered()
+    {
+        SettingsDialog dialog {*spSettings_, this};
+        QObject::connect (&dialog, &SettingsDialog::sigApply, [this, &dialog]()
+        {
+            applySettings (dialog.settings());
+        });
+
+        if (dialog.exec() == QDialog::Accepted)
+            applySettings (dialog.settings());
+    }
+
+    void pcmdft::applySettings (const PCMSettings& settings)
+    {
+        SettingsPtr spSettings {std::make_shared<const PCMSettings> (settings)};
+        int changes {settingsChanges (*spSettings_, *spSettings)};
+
+        if (changes == ChangeNone)
+            return;
+
+        spSettings_ = spSettings;
+        saveSettings (*spSettings_);
+
+        spTimer_->setInterval (1000 / std::max<std::size_t> (spSettings_->maxFps_, 1));
+        spTSBuf_.reset (new TSBuffer {spSettings_});
+        spFcBuf_.reset (new FreqBuffer {spSettings_});
+        cqCenters_ = constantQCenters (*spSettings_);
+
+        if (!spPCMThread_)
+            return;
+
+        //Only the affected stages are rebuilt, the others keep running
+        if (changes & ChangeRestart)
+        {
+            stopThreads();
+            slotStartClicked();
+            return;
+        }
+
+        if (changes & ChangeCapture)
+            spPCMThread_->reconfigure (spSettings_);
+
+        if (changes & ChangeTrigger)
+            emit sigReconfigureTrigger (spSettings_);
+
+        if (changes & ChangeTransform)
+            emit sigReconfigure (spSettings_);
+    }
+
     void pcmdft::slotStopClicked ()
     {
         spWindow_->btnStart->setEnabled (true);
@@ -111,16 +222,35 @@ namespace PCMDFT
 
         try
         {
-            spPCMThread_.reset (new PCMThread {spSettings_});
-            spDFTThread_.reset (new DFTThread {spSettings_, 0, platformIdx, deviceIdx});
-            QObject::connect (spPCMThread_.get(), &PCMThread::sigTimeSeriesReady, spDFTThread_.get(), &DFTThread::slotTimeSeriesUpdate);
-            QObject::connect (spDFTThread_.get(), &DFTThread::sigFreqCompReady, this, &pcmdft::slotFreqCompReady);
+            //Both pools hold blocks of one period, spectra have as many bytes as the time series
+            std::size_t blockSize {spSettings_->periodSize_ * spSettings_->frameSize_};
+            //The trigger holds back up to triggerPreRoll_ periods on top of the ones in flight
+            spPeriodPool_.reset (new BlockPool {spSettings_->poolBlocks_ + spSettings_->triggerPreRoll_, blockSize});
+            //Spectrum, cross-spectrum and constant-Q blocks share the second pool
+            spFreqPool_.reset (new BlockPool {3 * spSettings_->poolBlocks_, blockSize});
+            spMailbox_.reset (new Mailbox<SpectrumFrame>);
+            //The queues can hold every period block, so a push only fails if the pool grows
+            spCaptureQueue_.reset (new BlockQueue {spPeriodPool_->blocks()});
+            spTriggerQueue_.reset (new BlockQueue {spPeriodPool_->blocks()});
+            spPCMThread_.reset (new PCMThread {spSettings_, spPeriodPool_, spCaptureQueue_});
+            spTriggerThread_.reset (new TriggerThread {spSettings_, spCaptureQueue_, spTriggerQueue_});
+            spDFTThread_.reset (new DFTThread {spSettings_, spTriggerQueue_, spFreqPool_, spMailbox_, 0, platformIdx, deviceIdx});
+            statsTimer_.start();
+            statsPosted_ = 0;
+            QObject::connect (this, &pcmdft::sigQuit, spTriggerThread_.get(), &TriggerThread::slotQuit);
+            QObject::connect (this, &pcmdft::sigReconfigureTrigger, spTriggerThread_.get(), &TriggerThread::slotReconfigure);
+            QObject::connect (spTriggerThread_.get(), &TriggerThread::sigEventStarted, this, &pcmdft::slotEventStarted);
+            QObject::connect (spTriggerThread_.get(), &TriggerThread::sigEventFinished, this, &pcmdft::slotEventFinished);
+            QObject::connect (spTriggerThread_.get(), &TriggerThread::sigDebug, this, &pcmdft::slotDebug);
             QObject::connect (this, &pcmdft::sigQuit, spDFTThread_.get(), &DFTThread::slotQuit);
+            QObject::connect (this, &pcmdft::sigReconfigure, spDFTThread_.get(), &DFTThread::slotReconfigure);
             QObject::connect (spPCMThread_.get(), &PCMThread::sigError, this, &pcmdft::slotError);
             QObject::connect (spPCMThread_.get(), &PCMThread::sigDebug, this, &pcmdft::slotDebug);
+            QObject::connect (spPCMThread_.get(), &PCMThread::sigXrun, this, &pcmdft::slotXrun);
             QObject::connect (spDFTThread_.get(), &DFTThread::sigError, this, &pcmdft::slotError);
             QObject::connect (spDFTThread_.get(), &DFTThread::sigDebug, this, &pcmdft::slotDebug);
             spPCMThread_->start();
+            spTimer_->start();
         }
         catch
             (const std::exception& e)
@@ -144,39 +274,140 @@ namespace PCMDFT
         qDebug() << value;
     }
 
-    void pcmdft::slotFreqCompReady (QByteArray tsBytes, QByteArray fcBytes)
+    void pcmdft::slotEventStarted (quint64 event, qint64 timestamp, double level)
+    {
+        QString msg {tr ("Event #%1 at %2, level %3")
+                     .arg (event)
+                     .arg (QDateTime::fromMSecsSinceEpoch (timestamp).toString ("hh:mm:ss.zzz"))
+                     .arg (level, 0, 'g', 3)};
+        spWindow_->statusbar->showMessage (msg);
+        qDebug() << msg;
+    }
+
+    void pcmdft::slotEventFinished (quint64 event, quint64 periods, QString fileName)
     {
-        QVector<QPointF> lTs, rTs, lFc, rFc;
-        TSBuffer tsBuf {spSettings_, tsBytes};
-        FreqBuffer fcBuf {spSettings_, fcBytes};
+        QString msg {tr ("Event #%1 finished after %2 periods").arg (event).arg (periods)};
+
+        if (!fileName.isEmpty())
+            msg += tr (", recorded to %1").arg (fileName);
+
+        spWindow_->statusbar->showMessage (msg);
+        qDebug() << msg;
+    }
+
+    void pcmdft::slotXrun (quint64 count, qint64 timestamp, qint64 recoveryUs)
+    {
+        QString msg {tr ("xrun #%1 at %2, recovered in %3 ms")
+                     .arg (count)
+                     .arg (QDateTime::fromMSecsSinceEpoch (timestamp).toString ("hh:mm:ss.zzz"))
+                     .arg (recoveryUs / 1000., 0, 'f', 3)};
+        spWindow_->statusbar->showMessage (msg);
+        qDebug() << msg;
+    }
+
+    void pcmdft::slotRender()
+    {
+        //Only the newest spectrum is drawn, older ones were released by the mailbox already
+        SpectrumFrame frame;
+
+        if (!spMailbox_->take (frame))
+            return;
+
+        //Frames still in flight from before a channel count change
+        if (frame.spTs_->channels() != spSettings_->channels_)
+            return;
+
+        TSBuffer& tsBuf = *spTSBuf_;
+        FreqBuffer& fcBuf = *spFcBuf_;
+        tsBuf.assign (frame.spTs_->data(), frame.spTs_->size());
+        fcBuf.assign (frame.spFc_->data(), frame.spFc_->size());
+        std::vector<QPointF>& lTs = lTs_->samples(), &rTs = rTs_->samples(), &lFc = lFc_->samples(), &rFc = rFc_->samples();
+        lTs.clear();
+        rTs.clear();
+        lFc.clear();
+        rFc.clear();
         lTs.reserve (tsBuf.size () / tsBuf.size1());
         rTs.reserve (tsBuf.size () / tsBuf.size1());
         lFc.reserve (fcBuf.size () / fcBuf.size1());
         rFc.reserve (fcBuf.size () / fcBuf.size1());
 
 
-        for (int i = 0; i < tsBuf.size (); i += 2)
+        //Mono sources show the same channel in both plots
+        std::size_t rChnl {std::min<std::size_t> (1, tsBuf.size1() - 1)};
+
+        for (int i = 0; i < tsBuf.size (0); ++i)
         {
-            lTs.push_back (QPointF { (i / 2), tsBuf.at (0, i / 2) });
-            rTs.push_back (QPointF { (i / 2), tsBuf.at (1, i / 2) });
+            lTs.push_back (QPointF {static_cast<qreal> (i), tsBuf.at (0, i) });
+            rTs.push_back (QPointF {static_cast<qreal> (i), tsBuf.at (rChnl, i) });
         }
 
-        float deltaT {1. / spSettings_->rate_* spSettings_->periodSize_};
+        //Spectra hold N/2 bins per channel, or the display bins of a large transform, and the capture thread
+        //may have grown the period size, so the bin spacing is taken from the data
+        double fcStep {spSettings_->rate_ / (2. * fcBuf.size (0))};
 
-        for (int i = 2; i < fcBuf.size (); i += 2)
+        int view {spWindow_->comboView->currentIndex() };
+
+        if (view == ViewConstantQ && frame.spCq_)
         {
-            lFc.push_back (QPointF {1. / deltaT * (i / 2), fcBuf.at (0, i / 2) });
-            rFc.push_back (QPointF {1. / deltaT * (i / 2), fcBuf.at (1, i / 2) });
+            const SampleType* cq {reinterpret_cast<const SampleType*> (frame.spCq_->data()) };
+            std::size_t stride {frame.spCq_->size() / sizeof (SampleType) / tsBuf.size1() };
+            std::size_t bins {std::min (cqCenters_.size(), stride) };
+
+            for (std::size_t i = 0; i < bins; ++i)
+            {
+                lFc.push_back (QPointF {cqCenters_[i], cq[i] });
+                rFc.push_back (QPointF {cqCenters_[i], cq[rChnl * stride + i] });
+            }
         }
+        else if (view == ViewSpectrum || view == ViewConstantQ || !frame.spXs_)
+        {
+            for (int i = 1; i < fcBuf.size (0); ++i)
+            {
+                lFc.push_back (QPointF {fcStep * i, fcBuf.at (0, i) });
+                rFc.push_back (QPointF {fcStep * i, fcBuf.at (rChnl, i) });
+            }
+        }
+        else
+        {
+            //First channel pair: |Sxy| or coherence on the left, phase on the right
+            const SampleType* xs {reinterpret_cast<const SampleType*> (frame.spXs_->data()) };
+            int bins = tsBuf.size (0) / 2;
+            const SampleType* left {xs + (view == ViewCrossSpectrum ? 0 : bins) }, *phase {xs + 2 * bins};
+
+            for (int i = 1; i < bins; ++i)
+            {
+                lFc.push_back (QPointF {fcStep * i, left[i] });
+                rFc.push_back (QPointF {fcStep * i, phase[i] });
+            }
+        }
+
+        spWindow_->tsPlotL->replot();
+        spWindow_->tsPlotR->replot();
+        spWindow_->fcPlotL->replot();
+        spWindow_->fcPlotR->replot();
 
-        QwtPointSeriesData* lSeries = new QwtPointSeriesData {lTs};
-        QwtPointSeriesData* rSeries = new QwtPointSeriesData {rTs};
-        QwtPointSeriesData* lFcSeries = new QwtPointSeriesData {lFc};
-        QwtPointSeriesData* rFcSeries = new QwtPointSeriesData {rFc};
-        spLCurve_->setData (lSeries);
-        spRCurve_->setData (rSeries);
-        spLFcCurve_->setData (lFcSeries);
-        spRFcCurve_->setData (rFcSeries);
+        if (statsTimer_.elapsed() > 1000)
+        {
+            //Capture to screen latency of this frame and spectra per second since the last update
+            double latencyMs {std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now() -
+                              frame.spTs_->timestamp()).count()};
+            double rate {(spMailbox_->posted() - statsPosted_) * 1000. / statsTimer_.restart()};
+            statsPosted_ = spMailbox_->posted();
+            spWindow_->statusbar->showMessage (tr ("%7 spectra/s, latency %8 ms; heap allocations: %9 capture, %10 trigger, %11 DFT; "
+                                                   "pool reallocations: %1 period, %2 spectrum; "
+                                                   "dropped: %3 period, %4 spectrum; coalesced: %5 of %6 spectra")
+                                               .arg (spPeriodPool_->reallocations())
+                                               .arg (spFreqPool_->reallocations())
+                                               .arg (spPeriodPool_->misses() + spCaptureQueue_->dropped() + spTriggerQueue_->dropped())
+                                               .arg (spFreqPool_->misses())
+                                               .arg (spMailbox_->overwritten())
+                                               .arg (spMailbox_->posted())
+                                               .arg (rate, 0, 'f', 1)
+                                               .arg (latencyMs, 0, 'f', 1)
+                                               .arg (spPCMThread_->allocations())
+                                               .arg (spTriggerThread_->allocations())
+                                               .arg (spDFTThread_->allocations()));
+        }
     }
 
 }
@@ -6,8 +6,15 @@
 #include <QTimer>
 #include <QByteArray>
 #include <QMutex>
+#include <QElapsedTimer>
 
 #include <memory>
+#include <vector>
+
+#include "bufferpool.h"
+#include "mailbox.h"
+#include "blockqueue.h"
+#include "pcmsettings.h"
 
 namespace Ui
 {
@@ -19,8 +26,11 @@ class QwtPlotCurve;
 namespace PCMDFT
 {
     class PCMThread;
-    class PCMSettings;
     class DFTThread;
+    class TriggerThread;
+    class TSBuffer;
+    class FreqBuffer;
+    class SeriesData;
 
     class pcmdft : public QMainWindow
     {
@@ -36,24 +46,50 @@ namespace PCMDFT
 
     public slots:
         //void update();
-        void slotFreqCompReady (QByteArray tsBytes, QByteArray fcBytes);
+        void slotRender();
         void slotPlatformChanged (int platformIdx);
+        void slotViewChanged (int view);
         void slotError (QString value);
         void slotDebug (QString value);
+        void slotXrun (quint64 count, qint64 timestamp, qint64 recoveryUs);
+        void slotEventStarted (quint64 event, qint64 timestamp, double level);
+        void slotEventFinished (quint64 event, quint64 periods, QString fileName);
         void slotStartClicked();
         void slotStopClicked();
+        void slotSettingsTriggered();
 
     signals:
         void sigQuit();
+        void sigReconfigure (SettingsPtr spSettings);
+        void sigReconfigureTrigger (SettingsPtr spSettings);
 
     private:
+        //Entries of comboView, the cross-spectral views show the first channel pair
+        enum View
+        {
+            ViewSpectrum, ViewCrossSpectrum, ViewCoherence, ViewConstantQ
+        };
+
         void stopThreads();
+        void applySettings (const PCMSettings& settings);
         std::unique_ptr<PCMThread> spPCMThread_;
+        std::unique_ptr<TriggerThread> spTriggerThread_;
         std::unique_ptr<DFTThread> spDFTThread_;
         std::unique_ptr<QTimer> spTimer_;
         std::unique_ptr<Ui::MainWindow> spWindow_;
-        std::shared_ptr<PCMSettings> spSettings_;
+        SettingsPtr spSettings_;
         std::unique_ptr<QwtPlotCurve> spLCurve_, spRCurve_, spLFcCurve_, spRFcCurve_;
+        //Owned by the curves
+        SeriesData* lTs_, *rTs_, *lFc_, *rFc_;
+        std::shared_ptr<BlockPool> spPeriodPool_, spFreqPool_;
+        std::shared_ptr<Mailbox<SpectrumFrame>> spMailbox_;
+        //Captured periods to the trigger and triggered periods to the DFT thread
+        std::shared_ptr<BlockQueue> spCaptureQueue_, spTriggerQueue_;
+        std::unique_ptr<TSBuffer> spTSBuf_;
+        std::unique_ptr<FreqBuffer> spFcBuf_;
+        std::vector<double> cqCenters_;
+        QElapsedTimer statsTimer_;
+        std::size_t statsPosted_;
     };
 
 }
@@ -1,18 +1,92 @@
 #ifndef PCM_SETTINGS_H
 #define PCM_SETTINGS_H
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
 
 namespace PCMDFT
 {
 
     using SampleType = float;
 
+    enum class SourceType
+    {
+        Alsa,       //capture from pcmName_
+        File,       //raw interleaved SampleType frames from sourceFile_, looped
+        Generator   //deterministic tones, sweep and noise
+    };
+
+    enum class TriggerMode
+    {
+        None,       //every period is transformed
+        Rms,        //RMS of a period
+        Peak,       //largest absolute sample of a period
+        Band,       //amplitude in the band triggerFrom_ to triggerTo_, from a Goertzel bank
+        Flux        //rise of the Goertzel bank magnitudes against the previous period
+    };
+
     struct PCMSettings
     {
         //default settings
-        std::string pcmName_ {"plughw:0"}, clProgramName_ {"rdft.cl"}, clKernel_ {"rdft"};
+        std::string pcmName_ {"plughw:0"}, clProgramName_ {"rdft.cl"}, clKernel_ {"rdft"}, clCrossKernel_ {"xspec"},
+                    clConstantQKernel_ {"cqt"}, clFftColsKernel_ {"fft4_cols"}, clFftRowsKernel_ {"fft4_rows"},
+                    clPeakKernel_ {"fft_peak"};
         std::size_t sampleSize_ {sizeof (SampleType) }, rate_ {44100}, channels_ {2}, 
                         periodSize_ {8192}, periods_ {4}, frameSize_ {sampleSize_ * channels_};
+
+        //sample source, file and generator sources deliver at rate_ when paced and as fast as possible otherwise
+        SourceType source_ {SourceType::Alsa};
+        std::string sourceFile_ {};
+        bool pacedSource_ {true};
+
+        //generator, each channel gets the same signal with a phase lag of genChannelPhase_ radians per channel
+        std::vector<double> genTones_ {440., 1000.};
+        double genAmplitude_ {0.25}, genNoise_ {0.01}, genChannelPhase_ {0.1},
+               genSweepFrom_ {0.}, genSweepTo_ {0.}, genSweepSeconds_ {10.};
+        unsigned int genSeed_ {1};
+
+        //large transforms, 0 transforms every period on its own. Otherwise a power of two up to 4M, assembled
+        //from consecutive periods and transformed every fftHop_ frames (0 means every fftSize_ frames).
+        //The spectrum is reduced to fftDisplayBins_ peak-hold bins per channel before it is read back.
+        std::size_t fftSize_ {0}, fftHop_ {0}, fftDisplayBins_ {8192};
+
+        //cross-spectral analysis between channel pairs, averaged over frames with weight crossAlpha_ for the newest one,
+        //not available for large transforms
+        std::vector<std::pair<std::size_t, std::size_t>> crossPairs_ {{0, 1}};
+        double crossAlpha_ {0.1};
+
+        //constant-Q filterbank on top of the linear spectrum, e.g. 3 bins per octave for 1/3-octave bands.
+        //Bins below a few times rate_ / N only repeat the nearest linear bin, set fftSize_ to resolve them
+        std::size_t cqBinsPerOctave_ {12};
+        double cqMinFreq_ {27.5};
+
+        //trigger stage, only periods around events are transformed. The level of the largest channel is compared
+        //against triggerLevel_ (full scale 1.0), triggerBins_ Goertzel bins are spread evenly over the band.
+        //An event starts with triggerPreRoll_ periods of context and ends triggerPostRoll_ quiet periods later,
+        //events are written to triggerDir_ as raw files the file source can replay unless it is empty.
+        TriggerMode triggerMode_ {TriggerMode::None};
+        double triggerLevel_ {0.1}, triggerFrom_ {20.}, triggerTo_ {20000.};
+        std::size_t triggerBins_ {16}, triggerPreRoll_ {4}, triggerPostRoll_ {8};
+        std::string triggerDir_ {};
+
+        //real-time scheduling, a negative priority or cpu keeps the default policy / affinity
+        int captureRtPriority_ {-1}, dftRtPriority_ {-1}, captureCpu_ {-1}, dftCpu_ {-1};
+        bool lockMemory_ {false};
+
+        //adaptive period sizing, grow the period size (then the number of periods) once
+        //xrunThreshold_ xruns happen within xrunWindowMs_
+        std::size_t xrunThreshold_ {4}, xrunWindowMs_ {10000}, maxPeriodSize_ {65536}, maxPeriods_ {16};
+
+        //number of period and spectrum blocks in flight between capture, DFT and GUI
+        std::size_t poolBlocks_ {16};
+
+        //upper bound for GUI repaints per second, spectra arriving faster are coalesced
+        std::size_t maxFps_ {30};
     };
 
+    //Settings are never modified once shared, a change hands a new snapshot to the running stages
+    using SettingsPtr = std::shared_ptr<const PCMSettings>;
+
 }
 #endif
@@ -1,54 +1,24 @@
 #include "pcmthread.h"
 #include <QObject>
+#include <QDateTime>
 
 #include <iostream>
 
-#include <alsa/asoundlib.h>
-
 #include "pcmsettings.h"
 #include "buffer.h"
+#include "realtime.h"
+#include "allocationcounter.h"
+#include "samplesource.h"
 
 namespace PCMDFT
 {
 
-    class PCMThread::PCMHandle : public QObject
-    {
-        Q_OBJECT
-    public:
-        snd_pcm_t* pcm_handle_;
-
-        PCMHandle (const std::string& pcmName, snd_pcm_stream_t type)
-        {
-            int err;
-
-            if ( (err = snd_pcm_open (&pcm_handle_, pcmName.c_str (), type, 0)) < 0)
-                throw std::runtime_error (snd_strerror (err));
-
-            emit sigDebug ("Opened : " + QString::fromStdString (pcmName));
-        }
-        ~PCMHandle ()
-        {
-            snd_pcm_close (pcm_handle_);
-            emit sigDebug ("Closed PCM handle");
-        }
-        operator snd_pcm_t* ()
-        {
-            return pcm_handle_;
-        }
-        
-        //Prevent copying
-        PCMHandle (const PCMHandle&) = delete;
-        PCMHandle& operator= (const PCMHandle&) = delete;
-
-    signals:
-        void sigDebug (QString value);
-
-    };
-
-#include "pcmthread.moc"
-
-    PCMThread::PCMThread (std::shared_ptr<const PCMSettings> spSettings) :
-        QThread {}, spSettings_ {spSettings}, quit_ {false}
+    PCMThread::PCMThread (std::shared_ptr<const PCMSettings> spSettings, std::shared_ptr<BlockPool> spPool,
+                          std::shared_ptr<BlockQueue> spOutput) :
+        QThread {}, spSettings_ {spSettings}, spPool_ {spPool}, spOutput_ {spOutput},
+        scratch_ {spSettings->periodSize_ * spSettings->frameSize_}, quit_ {false},
+        periodSize_ {spSettings->periodSize_}, periods_ {spSettings->periods_}, xruns_ {0}, allocations_ {0},
+        reconfigure_ {false}
     {}
 
     PCMThread::~PCMThread () = default;
@@ -58,6 +28,18 @@ namespace PCMDFT
         quit_ = true;
     }
 
+    std::size_t PCMThread::allocations() const
+    {
+        return allocations_;
+    }
+
+    void PCMThread::reconfigure (std::shared_ptr<const PCMSettings> spSettings)
+    {
+        std::lock_guard<std::mutex> lock {pendingMutex_};
+        spPending_ = spSettings;
+        reconfigure_ = true;
+    }
+
     void PCMThread::slotDebug (QString value)
     {
         emit sigDebug (value);
@@ -65,64 +47,89 @@ namespace PCMDFT
 
     void PCMThread::init()
     {
-        snd_pcm_t* pcm_handle;
-        snd_pcm_hw_params_t* hwparams;
-        snd_pcm_uframes_t buffersize_return;
-        unsigned int tmp;
-        int err;
-
-        std::unique_ptr<PCMHandle> spPCMHandle {new PCMHandle {spSettings_->pcmName_, SND_PCM_STREAM_CAPTURE}};
-        QObject::connect (spPCMHandle.get(), &PCMThread::PCMHandle::sigDebug, this, &PCMThread::slotDebug);
-
-        snd_pcm_hw_params_alloca (&hwparams);
-
-        if ( (err = snd_pcm_hw_params_any (*spPCMHandle, hwparams)) < 0)
-            throw std::runtime_error (snd_strerror (err));
-
-        if ( (err = snd_pcm_hw_params_set_access (*spPCMHandle, hwparams, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0)
-            throw std::runtime_error (snd_strerror (err));
-
-        if ( (err = snd_pcm_hw_params_set_format (*spPCMHandle, hwparams, SND_PCM_FORMAT_FLOAT)) < 0)
-            throw std::runtime_error (snd_strerror (err));
-
-        tmp = spSettings_->rate_;
+        if (!spSource_)
+        {
+            spSource_ = SampleSource::create (spSettings_);
+            QObject::connect (spSource_.get(), &SampleSource::sigDebug, this, &PCMThread::slotDebug);
+        }
 
-        if ( (err = snd_pcm_hw_params_set_rate_near (*spPCMHandle, hwparams, &tmp, 0)) < 0)
-            throw std::runtime_error (snd_strerror (err));
+        spSource_->open (periodSize_, periods_);
+    }
 
-        tmp = spSettings_->channels_;
+    void PCMThread::recordXrun (Clock::time_point begin, Clock::time_point end)
+    {
+        qint64 recoveryUs {std::chrono::duration_cast<std::chrono::microseconds> (end - begin).count()};
+        ++xruns_;
+        emit sigXrun (xruns_, QDateTime::currentMSecsSinceEpoch(), recoveryUs);
 
-        if ( (err = snd_pcm_hw_params_set_channels (*spPCMHandle, hwparams, tmp)) < 0)
-            throw std::runtime_error (snd_strerror (err));
+        //Only the xruns within the window count towards the threshold
+        xrunWindow_.push_back (begin);
 
-        tmp = spSettings_->periods_;
+        while (!xrunWindow_.empty() &&
+                end - xrunWindow_.front() > std::chrono::milliseconds (spSettings_->xrunWindowMs_))
+        {
+            xrunWindow_.pop_front();
+        }
 
-        if ( (err = snd_pcm_hw_params_set_periods (*spPCMHandle, hwparams, tmp, 0)) < 0)
-            throw std::runtime_error (snd_strerror (err));
+        if (xrunWindow_.size() < spSettings_->xrunThreshold_)
+            return;
 
-        buffersize_return = spSettings_->periodSize_ * spSettings_->periods_;
+        xrunWindow_.clear();
+        std::size_t periodSize {periodSize_}, periods {periods_};
 
-        if ( (err = snd_pcm_hw_params_set_buffer_size_near (*spPCMHandle, hwparams, &buffersize_return)) < 0)
-            throw std::runtime_error (snd_strerror (err));
+        if (periodSize_ * 2 <= spSettings_->maxPeriodSize_)
+            periodSize_ *= 2;
+        else if (periods_ * 2 <= spSettings_->maxPeriods_)
+            periods_ *= 2;
+        else
+            return;
 
-        if (buffersize_return != static_cast<snd_pcm_uframes_t> (spSettings_->periodSize_ * spSettings_->periods_))
         {
             DebugHelper dbgHelper;
-            dbgHelper << "Period size " << spSettings_->periodSize_ << " not available, using " << 
-                            buffersize_return / spSettings_->periods_;
+            dbgHelper << xruns_ << " xruns, growing buffer to " << periods_ << " x " << periodSize_ << " frames";
             emit sigDebug (dbgHelper.string());
-            periodSize_ = buffersize_return / spSettings_->periods_;
         }
-        else
+
+        //A device refusing the larger buffer is not fatal, capture goes on with the previous geometry
+        try
         {
-            periodSize_ = spSettings_->periodSize_;
+            init();
         }
+        catch
+            (const std::exception& e)
+        {
+            periodSize_ = periodSize;
+            periods_ = periods;
+            emit sigDebug (QString {"Growing the buffer failed: "} + e.what() + ", keeping the previous geometry");
+            init();
+        }
+    }
+
+    void PCMThread::configureRealtime()
+    {
+        std::string rtErrors {configureThread ("capture", spSettings_->captureRtPriority_, spSettings_->captureCpu_)};
 
-        if ( (err = snd_pcm_hw_params (*spPCMHandle, hwparams)) < 0)
-            throw std::runtime_error (snd_strerror (err));
+        if (!rtErrors.empty())
+            emit sigDebug (QString::fromStdString (rtErrors));
+    }
 
-        spPCMHandle_ = std::move (spPCMHandle);
-        emit sigDebug ("Initialized : " + QString::fromStdString (spSettings_->pcmName_));
+    void PCMThread::applyPending()
+    {
+        {
+            std::lock_guard<std::mutex> lock {pendingMutex_};
+            spSettings_ = std::move (spPending_);
+            reconfigure_ = false;
+        }
+
+        //Start over with the configured geometry on a fresh source, which may be of another type
+        periodSize_ = spSettings_->periodSize_;
+        periods_ = spSettings_->periods_;
+        xrunWindow_.clear();
+        spSource_.reset (nullptr);
+        init();
+        scratch_.resize (periodSize_ * spSettings_->frameSize_);
+        configureRealtime();
+        emit sigDebug ("Capture reconfigured");
     }
 
     void PCMThread::run()
@@ -130,22 +137,54 @@ namespace PCMDFT
         try
         {
             init ();
+            configureRealtime();
+
+            if (spSettings_->lockMemory_)
+            {
+                int err {lockMemory()};
+
+                if (err != 0)
+                    emit sigDebug (QString {"mlockall failed: "} + std::strerror (err));
+            }
 
             while (!quit_)
             {
-                QByteArray bytes;
-                bytes.reserve (periodSize_ * spSettings_->frameSize_);
-                snd_pcm_sframes_t nframes;
+                if (reconfigure_)
+                    applyPending();
+
+                AllocationScope allocationScope {allocations_};
 
-                while ( (nframes = snd_pcm_readi (*spPCMHandle_, bytes.data(),
-                                                  periodSize_)) < 0)
+                BlockPtr spBlock {spPool_->acquire (periodSize_ * spSettings_->frameSize_)};
+                Block& block = spBlock ? *spBlock : scratch_;
+                block.resize (periodSize_ * spSettings_->frameSize_);
+                long nframes;
+                bool xrun {false};
+                Clock::time_point xrunBegin, xrunEnd;
+
+                while ( (nframes = spSource_->read (block.data(), periodSize_)) < 0)
                 {
-                    snd_pcm_prepare (*spPCMHandle_);
-                    emit sigDebug ("<<<<<<<<<<<<<<< Buffer Overrun >>>>>>>>>>>>>>>");
+                    if (!xrun)
+                    {
+                        xrun = true;
+                        xrunBegin = Clock::now();
+                        emit sigDebug ("<<<<<<<<<<<<<<< Buffer Overrun >>>>>>>>>>>>>>>");
+                    }
+
+                    spSource_->recover (nframes);
+                    //Only the recovery itself counts, not the wait for the next period
+                    xrunEnd = Clock::now();
                 }
 
-                bytes.resize (nframes * spSettings_->frameSize_);
-                emit sigTimeSeriesReady (bytes);
+                block.resize (nframes * spSettings_->frameSize_);
+                block.setChannels (spSettings_->channels_);
+                block.setDiscontinuity (xrun);
+                block.stamp();
+
+                if (spBlock)
+                    spOutput_->push (std::move (spBlock));
+
+                if (xrun)
+                    recordXrun (xrunBegin, xrunEnd);
             }
         }
         catch
@@ -4,12 +4,20 @@
 #include <QThread>
 #include <QByteArray>
 
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <memory>
+#include <mutex>
+
+#include "bufferpool.h"
+#include "blockqueue.h"
 
 namespace PCMDFT
 {
 
     class PCMSettings;
+    class SampleSource;
 
 
     class PCMThread : public QThread
@@ -17,26 +25,44 @@ namespace PCMDFT
         Q_OBJECT
 
     public:
-        PCMThread (std::shared_ptr<const PCMSettings> spSettings);
+        PCMThread (std::shared_ptr<const PCMSettings> spSettings, std::shared_ptr<BlockPool> spPool,
+                   std::shared_ptr<BlockQueue> spOutput);
         ~PCMThread ();
         void run();
         void init();
         void quit();
+        //Heap allocations made by the capture loop since start
+        std::size_t allocations() const;
+        //Reopen the source with new settings before the next period, the thread keeps running
+        void reconfigure (std::shared_ptr<const PCMSettings> spSettings);
 
     public slots:
         void slotDebug (QString value);
 
     signals:
-        void sigTimeSeriesReady (QByteArray bytes);
+        void sigXrun (quint64 count, qint64 timestamp, qint64 recoveryUs);
         void sigError (QString value);
         void sigDebug (QString value) const;
 
     private:
+        using Clock = std::chrono::steady_clock;
+        void recordXrun (Clock::time_point begin, Clock::time_point end);
+        void applyPending();
+        void configureRealtime();
         std::shared_ptr<const PCMSettings> spSettings_;
-        struct PCMHandle;
-        std::unique_ptr<PCMHandle> spPCMHandle_;
+        std::shared_ptr<BlockPool> spPool_;
+        //Captured periods go to the next stage through this queue
+        std::shared_ptr<BlockQueue> spOutput_;
+        //Periods are read into this block and dropped while the pool is exhausted
+        Block scratch_;
+        std::unique_ptr<SampleSource> spSource_;
         volatile bool quit_;
-        std::size_t periodSize_;
+        std::size_t periodSize_, periods_;
+        std::atomic<std::size_t> xruns_, allocations_;
+        std::deque<Clock::time_point> xrunWindow_;
+        std::mutex pendingMutex_;
+        std::shared_ptr<const PCMSettings> spPending_;
+        std::atomic<bool> reconfigure_;
     };
 
 }
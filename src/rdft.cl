@@ -4,9 +4,20 @@
 
 //#pragma OPENCL EXTENSION cl_khr_fp64 : enable
 
+//Dimension 0 is the frequency bin, dimension 1 the channel. Channel c reads x[c*N .. c*N+N-1] and
+//writes its packed spectrum (X_0, X_N/2, re/im pairs of X_1 .. X_N/2-1) to y[c*N .. c*N+N-1].
 __kernel void rdft(__global SAMPLETYPE *x, __global SAMPLETYPE *y, __const int N) {
 
-   //int N = (get_global_size(0)-1)*2;
+   int k = get_global_id(0);
+
+   //The global size is padded to a multiple of the local size
+   if(k > N/2) {
+      return;
+   }
+
+   x += get_global_id(1) * N;
+   y += get_global_id(1) * N;
+
    int num_vectors = N/4;
 
    SAMPLETYPE X_real = 0.0f;
@@ -14,7 +25,7 @@ __kernel void rdft(__global SAMPLETYPE *x, __global SAMPLETYPE *y, __const int N
 
    SAMPLEVEC input, arg, w_real, w_imag;
    SAMPLETYPE two_pi_k_over_N = 
-         2*M_PI_F*get_global_id(0)/N;
+         2*M_PI_F*k/N;
 
    for(int i=0; i<num_vectors; i++) {
       arg = (SAMPLEVEC) (two_pi_k_over_N*(i*4), 
@@ -30,15 +41,205 @@ __kernel void rdft(__global SAMPLETYPE *x, __global SAMPLETYPE *y, __const int N
    }
    //barrier(CLK_GLOBAL_MEM_FENCE);
 
-   if(get_global_id(0) == 0) {
+   if(k == 0) {
       y[0] = X_real;
    }
-   else if(get_global_id(0) == get_global_size(0)-1) {
+   else if(k == N/2) {
       y[1] = X_real;
    }
    else {
-      y[get_global_id(0) * 2] = X_real;
-      y[get_global_id(0) * 2 + 1] = X_imag;
+      y[k * 2] = X_real;
+      y[k * 2 + 1] = X_imag;
+   }
+}
+
+//Bin k of a packed spectrum as (re, im), the imaginary part of the DC bin is zero
+inline float2 packed_bin(__global const SAMPLETYPE *y, int k) {
+   return k == 0 ? (float2) (y[0], 0.0f) : vload2(k, y);
+}
+
+//Cross-spectral analysis of channel pairs on the packed spectra left in device memory by rdft.
+//Dimension 0 is the bin k < N/2, dimension 1 the pair. acc keeps the running averages
+//(Sxx, Syy, Re Sxy, Im Sxy) per pair and bin, updated as acc += alpha * (new - acc).
+//out receives per pair three arrays of N/2 values: |Sxy|, the magnitude-squared coherence and the phase of Sxy.
+__kernel void xspec(__global const SAMPLETYPE *spec, __global const int2 *pairs, __global float4 *acc,
+                    __global SAMPLETYPE *out, __const int N, __const SAMPLETYPE alpha) {
+
+   int k = get_global_id(0);
+   int pair = get_global_id(1);
+   int bins = N/2;
+
+   if(k >= bins) {
+      return;
    }
+
+   int2 chnls = pairs[pair];
+   float2 a = packed_bin(spec + chnls.x * N, k);
+   float2 b = packed_bin(spec + chnls.y * N, k);
+
+   //a * conj(b)
+   float4 cur = (float4) (dot(a, a), dot(b, b), a.x * b.x + a.y * b.y, a.y * b.x - a.x * b.y);
+   float4 avg = acc[pair * bins + k];
+   avg += alpha * (cur - avg);
+   acc[pair * bins + k] = avg;
+
+   float cross2 = avg.z * avg.z + avg.w * avg.w;
+   float power = avg.x * avg.y;
+
+   out += pair * 3 * bins;
+   out[k] = sqrt(cross2);
+   out[bins + k] = power > 0.0f ? cross2 / power : 0.0f;
+   out[2 * bins + k] = atan2(avg.w, avg.z);
+}
+
+//Constant-Q magnitudes from the packed spectra left in device memory by rdft. Dimension 0 is the
+//constant-Q bin, dimension 1 the channel. The sparse kernel is in compressed row format, bin k sums
+//weights[i] * |X_cols[i]|^2 for i in rows[k] .. rows[k+1]-1.
+__kernel void cqt(__global const SAMPLETYPE *spec, __global const int *rows, __global const int *cols,
+                  __global const SAMPLETYPE *weights, __global SAMPLETYPE *out, __const int N, __const int bins) {
+
+   int k = get_global_id(0);
+
+   if(k >= bins) {
+      return;
+   }
+
+   spec += get_global_id(1) * N;
+
+   SAMPLETYPE power = 0.0f;
+
+   for(int i = rows[k]; i < rows[k + 1]; i++) {
+      float2 x = packed_bin(spec, cols[i]);
+      power += weights[i] * dot(x, x);
+   }
+
+   out[get_global_id(1) * bins + k] = sqrt(power);
+}
+
+//Large transforms, N = N1 * N2 points with N1, N2 powers of two small enough for a sub-transform to
+//fit in local memory. Four-step algorithm: N2 column transforms of length N1 with twiddles, then N1
+//row transforms of length N2. A work-group handles one column / row, its work items loop over the
+//butterflies so the group may be smaller than half the sub-transform.
+
+inline float2 cmul(float2 a, float2 b) {
+   return (float2) (a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+//exp(-2 pi i num / den)
+inline float2 twiddle(int num, int den) {
+   float c;
+   float s = sincos(-2.0f * M_PI_F * (float) (num % den) / den, &c);
+   return (float2) (c, s);
+}
+
+inline int bit_reverse(int x, int bits) {
+   int r = 0;
+
+   for(int i = 0; i < bits; i++) {
+      r = (r << 1) | (x & 1);
+      x >>= 1;
+   }
+
+   return r;
 }
 
+//In-place radix-2 transform of M points loaded in bit-reversed order
+inline void fft_local(__local float2 *buf, int M) {
+   for(int span = 1; span < M; span <<= 1) {
+      barrier(CLK_LOCAL_MEM_FENCE);
+
+      for(int b = get_local_id(0); b < M / 2; b += get_local_size(0)) {
+         int j = b & (span - 1);
+         int i0 = ((b - j) << 1) + j;
+         int i1 = i0 + span;
+         float2 t = cmul(twiddle(j, span << 1), buf[i1]);
+         buf[i1] = buf[i0] - t;
+         buf[i0] = buf[i0] + t;
+      }
+   }
+
+   barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+//Step one and two. Group (n2, c) transforms column n2 of channel c, x is the ring buffer of real
+//samples of each channel with the oldest sample at start. Writes tmp[k1 * N2 + n2] = twiddled result.
+__kernel void fft4_cols(__global const SAMPLETYPE *x, __global float2 *tmp, __local float2 *buf,
+                        __const int N, __const int logN1, __const int start) {
+
+   int N1 = 1 << logN1;
+   int N2 = N / N1;
+   int n2 = get_group_id(0);
+
+   x += get_group_id(1) * N;
+   tmp += get_group_id(1) * N;
+
+   for(int n1 = get_local_id(0); n1 < N1; n1 += get_local_size(0)) {
+      buf[bit_reverse(n1, logN1)] = (float2) (x[(start + N2 * n1 + n2) & (N - 1)], 0.0f);
+   }
+
+   fft_local(buf, N1);
+
+   for(int k1 = get_local_id(0); k1 < N1; k1 += get_local_size(0)) {
+      tmp[k1 * N2 + n2] = cmul(buf[k1], twiddle(n2 * k1, N));
+   }
+}
+
+//Step three and four. Group (k1, c) transforms row k1 of channel c and scatters X[k1 + N1 * k2]
+//into the packed spectrum layout of rdft, so the other passes work on either transform.
+__kernel void fft4_rows(__global const float2 *tmp, __global SAMPLETYPE *y, __local float2 *buf,
+                        __const int N, __const int logN1) {
+
+   int N1 = 1 << logN1;
+   int N2 = N / N1;
+   int logN2 = 31 - clz(N2);
+   int k1 = get_group_id(0);
+
+   tmp += get_group_id(1) * N;
+   y += get_group_id(1) * N;
+
+   for(int n2 = get_local_id(0); n2 < N2; n2 += get_local_size(0)) {
+      buf[bit_reverse(n2, logN2)] = tmp[k1 * N2 + n2];
+   }
+
+   fft_local(buf, N2);
+
+   for(int k2 = get_local_id(0); k2 < N2; k2 += get_local_size(0)) {
+      int k = k1 + N1 * k2;
+
+      if(k == 0) {
+         y[0] = buf[k2].x;
+      }
+      else if(k == N/2) {
+         y[1] = buf[k2].x;
+      }
+      else if(k < N/2) {
+         vstore2(buf[k2], k, y);
+      }
+   }
+}
+
+//Peak-hold reduction of N/2 bins to bins display bins per channel, written as (magnitude, 0) pairs
+//so the result reads like a packed spectrum of 2 * bins points
+__kernel void fft_peak(__global const SAMPLETYPE *spec, __global SAMPLETYPE *out, __const int N, __const int bins) {
+
+   int k = get_global_id(0);
+
+   if(k >= bins) {
+      return;
+   }
+
+   int span = (N / 2) / bins;
+
+   spec += get_global_id(1) * N;
+   out += get_global_id(1) * 2 * bins;
+
+   SAMPLETYPE peak = 0.0f;
+
+   for(int j = k * span; j < (k + 1) * span; j++) {
+      float2 v = packed_bin(spec, j);
+      peak = max(peak, dot(v, v));
+   }
+
+   out[2 * k] = sqrt(peak);
+   out[2 * k + 1] = 0.0f;
+}
@@ -0,0 +1,73 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace PCMDFT
+{
+
+    //Switch the calling thread to SCHED_FIFO at the given priority, clamped to the range of the policy.
+    //A negative priority restores SCHED_OTHER so a running thread can be reconfigured back to the default policy
+    inline int setRealtimePriority (int priority)
+    {
+        sched_param param {};
+
+        if (priority < 0)
+            return pthread_setschedparam (pthread_self(), SCHED_OTHER, &param);
+
+        param.sched_priority = std::min (std::max (priority, sched_get_priority_min (SCHED_FIFO)),
+                                         sched_get_priority_max (SCHED_FIFO));
+        return pthread_setschedparam (pthread_self(), SCHED_FIFO, &param);
+    }
+
+    //Pin the calling thread to a single CPU, a negative cpu restores the affinity of the process
+    inline int setCpuAffinity (int cpu)
+    {
+        cpu_set_t cpuSet;
+        CPU_ZERO (&cpuSet);
+
+        if (cpu < 0)
+        {
+            //The main thread keeps the mask the process was started with, e.g. by taskset
+            if (sched_getaffinity (getpid(), sizeof (cpuSet), &cpuSet) < 0)
+                return errno;
+        }
+        else
+            CPU_SET (cpu, &cpuSet);
+
+        return pthread_setaffinity_np (pthread_self(), sizeof (cpuSet), &cpuSet);
+    }
+
+    //Lock current and future pages of the process into RAM
+    inline int lockMemory()
+    {
+        return mlockall (MCL_CURRENT | MCL_FUTURE) < 0 ? errno : 0;
+    }
+
+    //Apply priority and affinity to the calling thread, returns a description of what failed or an empty string.
+    //Failures are not fatal, without CAP_SYS_NICE the thread simply keeps running with the default policy.
+    inline std::string configureThread (const std::string& name, int priority, int cpu)
+    {
+        std::string errors;
+        int err;
+
+        if ( (err = setRealtimePriority (priority)) != 0)
+            errors += name + (priority < 0 ? std::string {": SCHED_OTHER"} : ": SCHED_FIFO " + std::to_string (priority)) +
+                      " failed (" + std::strerror (err) + ") ";
+
+        if ( (err = setCpuAffinity (cpu)) != 0)
+            errors += name + (cpu < 0 ? std::string {": resetting affinity"} : ": affinity to cpu " + std::to_string (cpu)) +
+                      " failed (" + std::strerror (err) + ")";
+
+        return errors;
+    }
+
+}
+#endif
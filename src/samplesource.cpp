@@ -0,0 +1,377 @@
+#include "samplesource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+#include <alsa/asoundlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pcmsettings.h"
+#include "buffer.h"
+
+namespace PCMDFT
+{
+
+    namespace
+    {
+
+        //Sleeps so that the frames handed out follow the sample rate in wall clock time
+        class Pacer
+        {
+        public:
+            explicit Pacer (std::size_t rate) : rate_ {rate}, frames_ {0}, start_ {Clock::now()}
+            {}
+
+            void reset()
+            {
+                frames_ = 0;
+                start_ = Clock::now();
+            }
+
+            void wait (std::size_t frames)
+            {
+                frames_ += frames;
+                std::this_thread::sleep_until (start_ + std::chrono::microseconds (frames_ * 1000000 / rate_));
+            }
+
+        private:
+            using Clock = std::chrono::steady_clock;
+            std::size_t rate_;
+            unsigned long long frames_;
+            Clock::time_point start_;
+        };
+
+
+        class AlsaSource : public SampleSource
+        {
+        public:
+            explicit AlsaSource (std::shared_ptr<const PCMSettings> spSettings) : spSettings_ {spSettings}
+            {}
+
+            ~AlsaSource() = default;
+
+            void open (std::size_t& periodSize, std::size_t periods) override
+            {
+                snd_pcm_hw_params_t* hwparams;
+                snd_pcm_uframes_t buffersize_return;
+                unsigned int tmp;
+                int err;
+
+                //The device can only be opened once, release the old handle when reconfiguring
+                if (spPCMHandle_)
+                {
+                    spPCMHandle_.reset (nullptr);
+                    emit sigDebug ("Closed PCM handle");
+                }
+
+                std::unique_ptr<PCMHandle> spPCMHandle {new PCMHandle {spSettings_->pcmName_, SND_PCM_STREAM_CAPTURE}};
+                emit sigDebug ("Opened : " + QString::fromStdString (spSettings_->pcmName_));
+
+                snd_pcm_hw_params_alloca (&hwparams);
+
+                if ( (err = snd_pcm_hw_params_any (*spPCMHandle, hwparams)) < 0)
+                    throw std::runtime_error (snd_strerror (err));
+
+                if ( (err = snd_pcm_hw_params_set_access (*spPCMHandle, hwparams, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0)
+                    throw std::runtime_error (snd_strerror (err));
+
+                if ( (err = snd_pcm_hw_params_set_format (*spPCMHandle, hwparams, SND_PCM_FORMAT_FLOAT)) < 0)
+                    throw std::runtime_error (snd_strerror (err));
+
+                tmp = spSettings_->rate_;
+
+                if ( (err = snd_pcm_hw_params_set_rate_near (*spPCMHandle, hwparams, &tmp, 0)) < 0)
+                    throw std::runtime_error (snd_strerror (err));
+
+                tmp = spSettings_->channels_;
+
+                if ( (err = snd_pcm_hw_params_set_channels (*spPCMHandle, hwparams, tmp)) < 0)
+                    throw std::runtime_error (snd_strerror (err));
+
+                tmp = periods;
+
+                if ( (err = snd_pcm_hw_params_set_periods (*spPCMHandle, hwparams, tmp, 0)) < 0)
+                    throw std::runtime_error (snd_strerror (err));
+
+                buffersize_return = periodSize * periods;
+
+                if ( (err = snd_pcm_hw_params_set_buffer_size_near (*spPCMHandle, hwparams, &buffersize_return)) < 0)
+                    throw std::runtime_error (snd_strerror (err));
+
+                if (buffersize_return != static_cast<snd_pcm_uframes_t> (periodSize * periods))
+                {
+                    DebugHelper dbgHelper;
+                    dbgHelper << "Period size " << periodSize << " not available, using " << 
+                                    buffersize_return / periods;
+                    emit sigDebug (dbgHelper.string());
+                    periodSize = buffersize_return / periods;
+                }
+
+                if ( (err = snd_pcm_hw_params (*spPCMHandle, hwparams)) < 0)
+                    throw std::runtime_error (snd_strerror (err));
+
+                spPCMHandle_ = std::move (spPCMHandle);
+                emit sigDebug ("Initialized : " + QString::fromStdString (spSettings_->pcmName_));
+            }
+
+            long read (char* dst, std::size_t frames) override
+            {
+                return snd_pcm_readi (*spPCMHandle_, dst, frames);
+            }
+
+            void recover (long err) override
+            {
+                int ret;
+
+                if ( (ret = snd_pcm_recover (*spPCMHandle_, err, 1)) < 0)
+                    throw std::runtime_error (snd_strerror (ret));
+            }
+
+        private:
+            struct PCMHandle
+            {
+                snd_pcm_t* pcm_handle_;
+
+                PCMHandle (const std::string& pcmName, snd_pcm_stream_t type)
+                {
+                    int err;
+
+                    if ( (err = snd_pcm_open (&pcm_handle_, pcmName.c_str (), type, 0)) < 0)
+                        throw std::runtime_error (snd_strerror (err));
+                }
+                ~PCMHandle ()
+                {
+                    snd_pcm_close (pcm_handle_);
+                }
+                operator snd_pcm_t* ()
+                {
+                    return pcm_handle_;
+                }
+
+                //Prevent copying
+                PCMHandle (const PCMHandle&) = delete;
+                PCMHandle& operator= (const PCMHandle&) = delete;
+            };
+
+            std::shared_ptr<const PCMSettings> spSettings_;
+            std::unique_ptr<PCMHandle> spPCMHandle_;
+        };
+
+
+        //Replays a raw file of interleaved frames through a read-only mapping, wrapping around at the end
+        class FileSource : public SampleSource
+        {
+        public:
+            explicit FileSource (std::shared_ptr<const PCMSettings> spSettings) :
+                spSettings_ {spSettings}, pacer_ {spSettings->rate_}, map_ {nullptr}, length_ {0}, pos_ {0}
+            {}
+
+            ~FileSource()
+            {
+                if (map_)
+                    munmap (map_, mapLength_);
+            }
+
+            void open (std::size_t&, std::size_t) override
+            {
+                pacer_.reset();
+
+                if (map_)
+                    return;
+
+                int fd = ::open (spSettings_->sourceFile_.c_str(), O_RDONLY);
+
+                if (fd < 0)
+                    throw std::runtime_error (spSettings_->sourceFile_ + ": " + std::strerror (errno));
+
+                struct stat st;
+
+                if (fstat (fd, &st) < 0 || st.st_size < static_cast<off_t> (spSettings_->frameSize_))
+                {
+                    ::close (fd);
+                    throw std::runtime_error (spSettings_->sourceFile_ + ": no complete frame");
+                }
+
+                mapLength_ = st.st_size;
+                void* map = mmap (nullptr, mapLength_, PROT_READ, MAP_PRIVATE, fd, 0);
+                ::close (fd);
+
+                if (map == MAP_FAILED)
+                    throw std::runtime_error (spSettings_->sourceFile_ + ": " + std::strerror (errno));
+
+                madvise (map, mapLength_, MADV_SEQUENTIAL);
+                map_ = static_cast<char*> (map);
+                length_ = mapLength_ - mapLength_ % spSettings_->frameSize_;
+                emit sigDebug ("Mapped : " + QString::fromStdString (spSettings_->sourceFile_));
+            }
+
+            long read (char* dst, std::size_t frames) override
+            {
+                std::size_t bytes {frames * spSettings_->frameSize_};
+
+                while (bytes)
+                {
+                    std::size_t chunk {std::min (bytes, length_ - pos_) };
+                    std::memcpy (dst, map_ + pos_, chunk);
+                    dst += chunk;
+                    bytes -= chunk;
+                    pos_ = (pos_ + chunk) % length_;
+                }
+
+                if (spSettings_->pacedSource_)
+                    pacer_.wait (frames);
+
+                return frames;
+            }
+
+            void recover (long) override
+            {}
+
+        private:
+            std::shared_ptr<const PCMSettings> spSettings_;
+            Pacer pacer_;
+            char* map_;
+            std::size_t mapLength_, length_, pos_;
+        };
+
+
+        //Deterministic test signal: fixed tones, an optional repeating linear sweep and uniform noise.
+        //Oscillators are complex phasors advanced by multiplication, so the cost per sample is a few
+        //multiplies per tone rather than a sin() call, which keeps high rates and channel counts affordable.
+        //The sweep's step phasor is itself rotated by a fixed chirp phasor, its frequency rises linearly.
+        class GeneratorSource : public SampleSource
+        {
+        public:
+            explicit GeneratorSource (std::shared_ptr<const PCMSettings> spSettings) :
+                spSettings_ {spSettings}, pacer_ {spSettings->rate_}, sweepPhasor_ {1.}, sweepPos_ {0},
+                sweepLength_ {std::max<std::size_t> (1, static_cast<std::size_t> (spSettings->genSweepSeconds_ * spSettings->rate_))}
+            {
+                const double twoPi {2. * M_PI};
+                //Frequency increment per sample of the linear sweep
+                double sweepRate {(spSettings_->genSweepTo_ - spSettings_->genSweepFrom_) / sweepLength_};
+                sweepStart_ = std::polar (1., twoPi * spSettings_->genSweepFrom_ / spSettings_->rate_);
+                sweepStep_ = sweepStart_;
+                sweepChirp_ = std::polar (1., twoPi * sweepRate / spSettings_->rate_);
+
+                for (double freq : spSettings_->genTones_)
+                {
+                    tones_.push_back (Tone {std::complex<double> {1.}, std::polar (1., twoPi * freq / spSettings_->rate_)});
+                }
+
+                for (std::size_t i = 0; i < spSettings_->channels_; ++i)
+                {
+                    lags_.push_back (std::polar (1., -spSettings_->genChannelPhase_ * i));
+                    noise_.emplace_back (spSettings_->genSeed_ + i);
+                }
+            }
+
+            void open (std::size_t&, std::size_t) override
+            {
+                pacer_.reset();
+                emit sigDebug ("Generator : " + QString::number (spSettings_->rate_) + " Hz, " +
+                               QString::number (spSettings_->channels_) + " channels");
+            }
+
+            long read (char* dst, std::size_t frames) override
+            {
+                SampleType* out = reinterpret_cast<SampleType*> (dst);
+                const std::size_t channels {spSettings_->channels_};
+                const double amplitude {spSettings_->genAmplitude_}, noise {spSettings_->genNoise_};
+                const bool sweep {spSettings_->genSweepTo_ > 0.};
+                std::uniform_real_distribution<float> noiseDist {-1.f, 1.f};
+
+                for (std::size_t i = 0; i < frames; ++i)
+                {
+                    std::complex<double> sum {0.};
+
+                    for (Tone& tone : tones_)
+                    {
+                        sum += tone.phasor_;
+                        tone.phasor_ *= tone.step_;
+                    }
+
+                    if (sweep)
+                    {
+                        sum += sweepPhasor_;
+                        sweepPhasor_ *= sweepStep_;
+                        sweepStep_ *= sweepChirp_;
+
+                        if (++sweepPos_ >= sweepLength_)
+                        {
+                            sweepPos_ = 0;
+                            sweepStep_ = sweepStart_;
+                        }
+                    }
+
+                    for (std::size_t c = 0; c < channels; ++c)
+                    {
+                        //Imaginary part of sum rotated by the channel lag
+                        SampleType s = amplitude * (sum.imag() * lags_[c].real() + sum.real() * lags_[c].imag());
+
+                        if (noise > 0.)
+                            s += noise * noiseDist (noise_[c]);
+
+                        out[i * channels + c] = s;
+                    }
+                }
+
+                //Keep the phasors on the unit circle
+                for (Tone& tone : tones_)
+                {
+                    tone.phasor_ /= std::abs (tone.phasor_);
+                }
+
+                sweepPhasor_ /= std::abs (sweepPhasor_);
+                sweepStep_ /= std::abs (sweepStep_);
+
+                if (spSettings_->pacedSource_)
+                    pacer_.wait (frames);
+
+                return frames;
+            }
+
+            void recover (long) override
+            {}
+
+        private:
+            struct Tone
+            {
+                std::complex<double> phasor_, step_;
+            };
+
+            std::shared_ptr<const PCMSettings> spSettings_;
+            Pacer pacer_;
+            std::vector<Tone> tones_;
+            std::vector<std::complex<double>> lags_;
+            std::vector<std::minstd_rand> noise_;
+            std::complex<double> sweepPhasor_, sweepStart_, sweepStep_, sweepChirp_;
+            std::size_t sweepPos_, sweepLength_;
+        };
+
+    }
+
+    std::unique_ptr<SampleSource> SampleSource::create (std::shared_ptr<const PCMSettings> spSettings)
+    {
+        switch (spSettings->source_)
+        {
+            case SourceType::File:
+                return std::unique_ptr<SampleSource> {new FileSource {spSettings}};
+
+            case SourceType::Generator:
+                return std::unique_ptr<SampleSource> {new GeneratorSource {spSettings}};
+
+            case SourceType::Alsa:
+            default:
+                return std::unique_ptr<SampleSource> {new AlsaSource {spSettings}};
+        }
+    }
+
+}
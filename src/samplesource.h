@@ -0,0 +1,40 @@
+#ifndef SAMPLE_SOURCE_H
+#define SAMPLE_SOURCE_H
+#include <QObject>
+#include <QString>
+
+#include <memory>
+
+namespace PCMDFT
+{
+
+    class PCMSettings;
+
+    //Producer of interleaved frames for PCMThread. Implementations are opened, read and
+    //closed on the capture thread only.
+    class SampleSource : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        virtual ~SampleSource() = default;
+
+        //(Re)open the source, periodSize may be adjusted to what the source supports
+        virtual void open (std::size_t& periodSize, std::size_t periods) = 0;
+
+        //Read up to frames frames into dst, returns the number of frames read or a negative error code
+        virtual long read (char* dst, std::size_t frames) = 0;
+
+        //Recover from a negative read() result, throws if the error is fatal
+        virtual void recover (long err) = 0;
+
+        //Create the source selected in the settings
+        static std::unique_ptr<SampleSource> create (std::shared_ptr<const PCMSettings> spSettings);
+
+    signals:
+        void sigDebug (QString value);
+    };
+
+}
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SERIES_DATA_H
+#define SERIES_DATA_H
+#include <QPointF>
+#include <QRectF>
+#include <qwt_series_data.h>
+
+#include <vector>
+
+namespace PCMDFT
+{
+
+    //Curve data that is refilled in place every frame instead of being replaced,
+    //the samples keep their capacity so a steady frame size does not allocate
+    class SeriesData : public QwtSeriesData<QPointF>
+    {
+    public:
+        SeriesData() = default;
+        ~SeriesData() = default;
+
+        size_t size() const
+        {
+            return samples_.size();
+        }
+
+        QPointF sample (size_t i) const
+        {
+            return samples_[i];
+        }
+
+        QRectF boundingRect() const
+        {
+            if (d_boundingRect.width() < 0)
+                d_boundingRect = qwtBoundingRect (*this);
+
+            return d_boundingRect;
+        }
+
+        //Start a new frame, the caller refills samples() and the bounding rect is recalculated on demand
+        std::vector<QPointF>& samples()
+        {
+            d_boundingRect = QRectF {0.0, 0.0, -1.0, -1.0};
+            return samples_;
+        }
+
+    private:
+        std::vector<QPointF> samples_;
+    };
+
+}
+#endif
@@ -0,0 +1,183 @@
+#include "settingsdialog.h"
+#include <QComboBox>
+#include <QLineEdit>
+#include <QSpinBox>
+#include <QDoubleSpinBox>
+#include <QCheckBox>
+#include <QFormLayout>
+#include <QDialogButtonBox>
+#include <QPushButton>
+
+#include <algorithm>
+
+namespace PCMDFT
+{
+
+    SettingsDialog::SettingsDialog (const PCMSettings& settings, QWidget* parent) :
+        QDialog {parent}, settings_ {settings}
+    {
+        setWindowTitle (tr ("Settings"));
+        QFormLayout* layout {new QFormLayout {this}};
+
+        comboSource_ = new QComboBox {this};
+        comboSource_->insertItems (0, QStringList {tr ("ALSA"), tr ("File"), tr ("Generator")});
+        comboSource_->setCurrentIndex (static_cast<int> (settings.source_));
+        layout->addRow (tr ("Source:"), comboSource_);
+
+        editPcmName_ = new QLineEdit {QString::fromStdString (settings.pcmName_), this};
+        layout->addRow (tr ("PCM device:"), editPcmName_);
+
+        editSourceFile_ = new QLineEdit {QString::fromStdString (settings.sourceFile_), this};
+        layout->addRow (tr ("Source file:"), editSourceFile_);
+
+        checkPaced_ = new QCheckBox {tr ("Deliver file and generator at the sample rate"), this};
+        checkPaced_->setChecked (settings.pacedSource_);
+        layout->addRow (checkPaced_);
+
+        spinRate_ = new QSpinBox {this};
+        spinRate_->setRange (1000, 768000);
+        spinRate_->setValue (settings.rate_);
+        layout->addRow (tr ("Rate:"), spinRate_);
+
+        spinChannels_ = new QSpinBox {this};
+        spinChannels_->setRange (1, 64);
+        spinChannels_->setValue (settings.channels_);
+        layout->addRow (tr ("Channels:"), spinChannels_);
+
+        spinPeriodSize_ = new QSpinBox {this};
+        spinPeriodSize_->setRange (16, 1 << 20);
+        spinPeriodSize_->setValue (settings.periodSize_);
+        layout->addRow (tr ("Period size:"), spinPeriodSize_);
+
+        spinPeriods_ = new QSpinBox {this};
+        spinPeriods_->setRange (2, 64);
+        spinPeriods_->setValue (settings.periods_);
+        layout->addRow (tr ("Periods:"), spinPeriods_);
+
+        //Entry 0 transforms every period on its own, the others are the large transform sizes
+        comboFftSize_ = new QComboBox {this};
+        comboFftSize_->addItem (tr ("Period size"), 0);
+
+        for (int logN = 12; logN <= 22; ++logN)
+        {
+            comboFftSize_->addItem (QString::number (1 << logN), 1 << logN);
+        }
+
+        comboFftSize_->setCurrentIndex (std::max (0, comboFftSize_->findData (static_cast<int> (settings.fftSize_))));
+        layout->addRow (tr ("FFT size:"), comboFftSize_);
+
+        spinFftHop_ = new QSpinBox {this};
+        spinFftHop_->setRange (0, 1 << 22);
+        spinFftHop_->setSpecialValueText (tr ("FFT size"));
+        spinFftHop_->setValue (settings.fftHop_);
+        layout->addRow (tr ("FFT hop:"), spinFftHop_);
+
+        spinDisplayBins_ = new QSpinBox {this};
+        spinDisplayBins_->setRange (64, 1 << 16);
+        spinDisplayBins_->setValue (settings.fftDisplayBins_);
+        layout->addRow (tr ("Display bins:"), spinDisplayBins_);
+
+        spinCrossAlpha_ = new QDoubleSpinBox {this};
+        spinCrossAlpha_->setRange (0.001, 1.);
+        spinCrossAlpha_->setDecimals (3);
+        spinCrossAlpha_->setSingleStep (0.01);
+        spinCrossAlpha_->setValue (settings.crossAlpha_);
+        layout->addRow (tr ("Cross-spectrum averaging:"), spinCrossAlpha_);
+
+        spinCqBins_ = new QSpinBox {this};
+        spinCqBins_->setRange (0, 96);
+        spinCqBins_->setSpecialValueText (tr ("Off"));
+        spinCqBins_->setValue (settings.cqBinsPerOctave_);
+        layout->addRow (tr ("Constant-Q bins per octave:"), spinCqBins_);
+
+        spinCqMinFreq_ = new QDoubleSpinBox {this};
+        spinCqMinFreq_->setRange (1., 20000.);
+        spinCqMinFreq_->setValue (settings.cqMinFreq_);
+        layout->addRow (tr ("Constant-Q lowest frequency:"), spinCqMinFreq_);
+
+        comboTriggerMode_ = new QComboBox {this};
+        comboTriggerMode_->insertItems (0, QStringList {tr ("Off"), tr ("RMS"), tr ("Peak"), tr ("Band energy"), tr ("Spectral flux")});
+        comboTriggerMode_->setCurrentIndex (static_cast<int> (settings.triggerMode_));
+        layout->addRow (tr ("Trigger:"), comboTriggerMode_);
+
+        spinTriggerLevel_ = new QDoubleSpinBox {this};
+        spinTriggerLevel_->setRange (0., 10.);
+        spinTriggerLevel_->setDecimals (4);
+        spinTriggerLevel_->setSingleStep (0.01);
+        spinTriggerLevel_->setValue (settings.triggerLevel_);
+        layout->addRow (tr ("Trigger level:"), spinTriggerLevel_);
+
+        spinTriggerFrom_ = new QDoubleSpinBox {this};
+        spinTriggerFrom_->setRange (0., 384000.);
+        spinTriggerFrom_->setValue (settings.triggerFrom_);
+        layout->addRow (tr ("Trigger band from:"), spinTriggerFrom_);
+
+        spinTriggerTo_ = new QDoubleSpinBox {this};
+        spinTriggerTo_->setRange (0., 384000.);
+        spinTriggerTo_->setValue (settings.triggerTo_);
+        layout->addRow (tr ("Trigger band to:"), spinTriggerTo_);
+
+        spinTriggerBins_ = new QSpinBox {this};
+        spinTriggerBins_->setRange (1, 256);
+        spinTriggerBins_->setValue (settings.triggerBins_);
+        layout->addRow (tr ("Trigger band bins:"), spinTriggerBins_);
+
+        spinPreRoll_ = new QSpinBox {this};
+        spinPreRoll_->setRange (0, 256);
+        spinPreRoll_->setValue (settings.triggerPreRoll_);
+        layout->addRow (tr ("Pre-trigger periods:"), spinPreRoll_);
+
+        spinPostRoll_ = new QSpinBox {this};
+        spinPostRoll_->setRange (0, 256);
+        spinPostRoll_->setValue (settings.triggerPostRoll_);
+        layout->addRow (tr ("Post-trigger periods:"), spinPostRoll_);
+
+        editTriggerDir_ = new QLineEdit {QString::fromStdString (settings.triggerDir_), this};
+        editTriggerDir_->setPlaceholderText (tr ("Do not record"));
+        layout->addRow (tr ("Event directory:"), editTriggerDir_);
+
+        spinMaxFps_ = new QSpinBox {this};
+        spinMaxFps_->setRange (1, 240);
+        spinMaxFps_->setValue (settings.maxFps_);
+        layout->addRow (tr ("Max. frames per second:"), spinMaxFps_);
+
+        QDialogButtonBox* buttons {new QDialogButtonBox {QDialogButtonBox::Ok | QDialogButtonBox::Apply | QDialogButtonBox::Cancel, this}};
+        layout->addRow (buttons);
+        QObject::connect (buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+        QObject::connect (buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+        QObject::connect (buttons->button (QDialogButtonBox::Apply), &QPushButton::clicked, this, &SettingsDialog::sigApply);
+    }
+
+    SettingsDialog::~SettingsDialog() = default;
+
+    PCMSettings SettingsDialog::settings() const
+    {
+        PCMSettings settings {settings_};
+        settings.source_ = static_cast<SourceType> (comboSource_->currentIndex());
+        settings.pcmName_ = editPcmName_->text().toStdString();
+        settings.sourceFile_ = editSourceFile_->text().toStdString();
+        settings.pacedSource_ = checkPaced_->isChecked();
+        settings.rate_ = spinRate_->value();
+        settings.channels_ = spinChannels_->value();
+        settings.frameSize_ = settings.sampleSize_ * settings.channels_;
+        settings.periodSize_ = spinPeriodSize_->value();
+        settings.periods_ = spinPeriods_->value();
+        settings.fftSize_ = comboFftSize_->currentData().toULongLong();
+        settings.fftHop_ = spinFftHop_->value();
+        settings.fftDisplayBins_ = spinDisplayBins_->value();
+        settings.crossAlpha_ = spinCrossAlpha_->value();
+        settings.cqBinsPerOctave_ = spinCqBins_->value();
+        settings.cqMinFreq_ = spinCqMinFreq_->value();
+        settings.triggerMode_ = static_cast<TriggerMode> (comboTriggerMode_->currentIndex());
+        settings.triggerLevel_ = spinTriggerLevel_->value();
+        settings.triggerFrom_ = spinTriggerFrom_->value();
+        settings.triggerTo_ = spinTriggerTo_->value();
+        settings.triggerBins_ = spinTriggerBins_->value();
+        settings.triggerPreRoll_ = spinPreRoll_->value();
+        settings.triggerPostRoll_ = spinPostRoll_->value();
+        settings.triggerDir_ = editTriggerDir_->text().toStdString();
+        settings.maxFps_ = spinMaxFps_->value();
+        return settings;
+    }
+
+}
@@ -0,0 +1,42 @@
+#ifndef SETTINGS_DIALOG_H
+#define SETTINGS_DIALOG_H
+#include <QDialog>
+
+#include "pcmsettings.h"
+
+class QComboBox;
+class QLineEdit;
+class QSpinBox;
+class QDoubleSpinBox;
+class QCheckBox;
+
+namespace PCMDFT
+{
+
+    //Edits the runtime settings, everything else is only available through the config file
+    class SettingsDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        SettingsDialog (const PCMSettings& settings, QWidget* parent = 0);
+        ~SettingsDialog();
+
+        PCMSettings settings() const;
+
+    signals:
+        //Apply was clicked, the dialog stays open
+        void sigApply();
+
+    private:
+        PCMSettings settings_;
+        QComboBox* comboSource_, *comboFftSize_, *comboTriggerMode_;
+        QLineEdit* editPcmName_, *editSourceFile_, *editTriggerDir_;
+        QSpinBox* spinRate_, *spinChannels_, *spinPeriodSize_, *spinPeriods_, *spinFftHop_, *spinDisplayBins_,
+                  *spinCqBins_, *spinMaxFps_, *spinTriggerBins_, *spinPreRoll_, *spinPostRoll_;
+        QDoubleSpinBox* spinCqMinFreq_, *spinCrossAlpha_, *spinTriggerLevel_, *spinTriggerFrom_, *spinTriggerTo_;
+        QCheckBox* checkPaced_;
+    };
+
+}
+#endif
@@ -0,0 +1,333 @@
+#include "settingsstore.h"
+#include <QSettings>
+#include <QStringList>
+
+#include <memory>
+
+namespace PCMDFT
+{
+
+    namespace
+    {
+
+        std::unique_ptr<QSettings> openStore (const QString& fileName)
+        {
+            if (fileName.isEmpty())
+                return std::unique_ptr<QSettings> {new QSettings {QSettings::IniFormat, QSettings::UserScope, "pcmdft", "pcmdft"}};
+
+            return std::unique_ptr<QSettings> {new QSettings {fileName, QSettings::IniFormat}};
+        }
+
+        template <typename T>
+        void read (QSettings& store, const QString& key, T& value)
+        {
+            value = store.value (key, QVariant::fromValue (value)).template value<T>();
+        }
+
+        void read (QSettings& store, const QString& key, std::size_t& value)
+        {
+            value = store.value (key, static_cast<qulonglong> (value)).toULongLong();
+        }
+
+        void read (QSettings& store, const QString& key, std::string& value)
+        {
+            value = store.value (key, QString::fromStdString (value)).toString().toStdString();
+        }
+
+        void write (QSettings& store, const QString& key, std::size_t value)
+        {
+            store.setValue (key, static_cast<qulonglong> (value));
+        }
+
+        void write (QSettings& store, const QString& key, const std::string& value)
+        {
+            store.setValue (key, QString::fromStdString (value));
+        }
+
+        template <typename T>
+        void write (QSettings& store, const QString& key, const T& value)
+        {
+            store.setValue (key, value);
+        }
+
+        //Values outside the range the settings dialog offers fall back to the default, NaN included
+        template <typename T>
+        void limit (T& value, T min, T max, T fallback)
+        {
+            if (! (value >= min && value <= max))
+                value = fallback;
+        }
+
+        //0 or one of the large transform sizes in the settings dialog, a power of two from 4096 to 4M
+        bool validFftSize (std::size_t n)
+        {
+            return !n || (n >= (1 << 12) && n <= (1 << 22) && ! (n & (n - 1)));
+        }
+
+        //QString::SkipEmptyParts is deprecated since Qt 5.14 in favour of Qt::SkipEmptyParts
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        const auto skipEmptyParts = Qt::SkipEmptyParts;
+#else
+        const auto skipEmptyParts = QString::SkipEmptyParts;
+#endif
+
+        //Tones as "440,1000", pairs as "0-1,0-2"
+        QString joinTones (const std::vector<double>& tones)
+        {
+            QStringList list;
+
+            for (double tone : tones)
+            {
+                list << QString::number (tone);
+            }
+
+            return list.join (',');
+        }
+
+        std::vector<double> splitTones (const QString& value)
+        {
+            std::vector<double> tones;
+
+            for (const QString& tone : value.split (',', skipEmptyParts))
+            {
+                tones.push_back (tone.toDouble());
+            }
+
+            return tones;
+        }
+
+        QString joinPairs (const std::vector<std::pair<std::size_t, std::size_t>>& pairs)
+        {
+            QStringList list;
+
+            for (const auto& pair : pairs)
+            {
+                list << QString {"%1-%2"}.arg (pair.first).arg (pair.second);
+            }
+
+            return list.join (',');
+        }
+
+        std::vector<std::pair<std::size_t, std::size_t>> splitPairs (const QString& value)
+        {
+            std::vector<std::pair<std::size_t, std::size_t>> pairs;
+
+            for (const QString& pair : value.split (',', skipEmptyParts))
+            {
+                QStringList chnls {pair.split ('-') };
+
+                if (chnls.size() == 2)
+                    pairs.emplace_back (chnls[0].toULongLong(), chnls[1].toULongLong());
+            }
+
+            return pairs;
+        }
+
+    }
+
+    int settingsChanges (const PCMSettings& from, const PCMSettings& to)
+    {
+        int changes {ChangeNone};
+
+        if (from.clProgramName_ != to.clProgramName_ || from.clKernel_ != to.clKernel_ ||
+                from.clCrossKernel_ != to.clCrossKernel_ || from.clConstantQKernel_ != to.clConstantQKernel_ ||
+                from.clFftColsKernel_ != to.clFftColsKernel_ || from.clFftRowsKernel_ != to.clFftRowsKernel_ ||
+                from.clPeakKernel_ != to.clPeakKernel_ || from.poolBlocks_ != to.poolBlocks_ ||
+                from.triggerPreRoll_ != to.triggerPreRoll_ ||
+                from.lockMemory_ != to.lockMemory_ || from.dftRtPriority_ != to.dftRtPriority_ ||
+                from.dftCpu_ != to.dftCpu_)
+            changes |= ChangeRestart;
+
+        if (from.source_ != to.source_ || from.pcmName_ != to.pcmName_ || from.sourceFile_ != to.sourceFile_ ||
+                from.pacedSource_ != to.pacedSource_ || from.rate_ != to.rate_ || from.channels_ != to.channels_ ||
+                from.periodSize_ != to.periodSize_ || from.periods_ != to.periods_ ||
+                from.genTones_ != to.genTones_ || from.genAmplitude_ != to.genAmplitude_ ||
+                from.genNoise_ != to.genNoise_ || from.genChannelPhase_ != to.genChannelPhase_ ||
+                from.genSweepFrom_ != to.genSweepFrom_ || from.genSweepTo_ != to.genSweepTo_ ||
+                from.genSweepSeconds_ != to.genSweepSeconds_ || from.genSeed_ != to.genSeed_ ||
+                from.captureRtPriority_ != to.captureRtPriority_ || from.captureCpu_ != to.captureCpu_ ||
+                from.xrunThreshold_ != to.xrunThreshold_ || from.xrunWindowMs_ != to.xrunWindowMs_ ||
+                from.maxPeriodSize_ != to.maxPeriodSize_ || from.maxPeriods_ != to.maxPeriods_)
+            changes |= ChangeCapture;
+
+        //The constant-Q kernel depends on the rate and the channel count on the capture settings
+        if (from.fftSize_ != to.fftSize_ || from.fftHop_ != to.fftHop_ || from.fftDisplayBins_ != to.fftDisplayBins_ ||
+                from.crossPairs_ != to.crossPairs_ || from.crossAlpha_ != to.crossAlpha_ ||
+                from.cqBinsPerOctave_ != to.cqBinsPerOctave_ || from.cqMinFreq_ != to.cqMinFreq_ ||
+                from.rate_ != to.rate_ || from.channels_ != to.channels_)
+            changes |= ChangeTransform;
+
+        if (from.triggerMode_ != to.triggerMode_ || from.triggerLevel_ != to.triggerLevel_ ||
+                from.triggerFrom_ != to.triggerFrom_ || from.triggerTo_ != to.triggerTo_ ||
+                from.triggerBins_ != to.triggerBins_ || from.triggerPostRoll_ != to.triggerPostRoll_ ||
+                from.triggerDir_ != to.triggerDir_ || from.rate_ != to.rate_ || from.channels_ != to.channels_)
+            changes |= ChangeTrigger;
+
+        if (from.maxFps_ != to.maxFps_)
+            changes |= ChangeGui;
+
+        return changes;
+    }
+
+    void loadSettings (PCMSettings& settings, const QString& fileName)
+    {
+        std::unique_ptr<QSettings> spStore {openStore (fileName) };
+        QSettings& store = *spStore;
+        const PCMSettings defaults;
+        int source {static_cast<int> (settings.source_) }, triggerMode {static_cast<int> (settings.triggerMode_) };
+
+        store.beginGroup ("capture");
+        read (store, "source", source);
+        read (store, "pcmName", settings.pcmName_);
+        read (store, "sourceFile", settings.sourceFile_);
+        read (store, "paced", settings.pacedSource_);
+        read (store, "rate", settings.rate_);
+        read (store, "channels", settings.channels_);
+        read (store, "periodSize", settings.periodSize_);
+        read (store, "periods", settings.periods_);
+        read (store, "xrunThreshold", settings.xrunThreshold_);
+        read (store, "xrunWindowMs", settings.xrunWindowMs_);
+        read (store, "maxPeriodSize", settings.maxPeriodSize_);
+        read (store, "maxPeriods", settings.maxPeriods_);
+        read (store, "poolBlocks", settings.poolBlocks_);
+        store.endGroup();
+        limit (source, static_cast<int> (SourceType::Alsa), static_cast<int> (SourceType::Generator), static_cast<int> (defaults.source_));
+        limit<std::size_t> (settings.rate_, 1000, 768000, defaults.rate_);
+        limit<std::size_t> (settings.channels_, 1, 64, defaults.channels_);
+        limit<std::size_t> (settings.periodSize_, 16, 1 << 20, defaults.periodSize_);
+        limit<std::size_t> (settings.periods_, 2, 64, defaults.periods_);
+        settings.source_ = static_cast<SourceType> (source);
+        settings.frameSize_ = settings.sampleSize_ * settings.channels_;
+
+        store.beginGroup ("generator");
+        settings.genTones_ = splitTones (store.value ("tones", joinTones (settings.genTones_)).toString());
+        read (store, "amplitude", settings.genAmplitude_);
+        read (store, "noise", settings.genNoise_);
+        read (store, "channelPhase", settings.genChannelPhase_);
+        read (store, "sweepFrom", settings.genSweepFrom_);
+        read (store, "sweepTo", settings.genSweepTo_);
+        read (store, "sweepSeconds", settings.genSweepSeconds_);
+        read (store, "seed", settings.genSeed_);
+        store.endGroup();
+
+        store.beginGroup ("transform");
+        read (store, "program", settings.clProgramName_);
+        read (store, "fftSize", settings.fftSize_);
+        read (store, "fftHop", settings.fftHop_);
+        read (store, "fftDisplayBins", settings.fftDisplayBins_);
+        settings.crossPairs_ = splitPairs (store.value ("crossPairs", joinPairs (settings.crossPairs_)).toString());
+        read (store, "crossAlpha", settings.crossAlpha_);
+        read (store, "cqBinsPerOctave", settings.cqBinsPerOctave_);
+        read (store, "cqMinFreq", settings.cqMinFreq_);
+        store.endGroup();
+
+        if (!validFftSize (settings.fftSize_))
+            settings.fftSize_ = defaults.fftSize_;
+
+        limit<std::size_t> (settings.fftHop_, 0, 1 << 22, defaults.fftHop_);
+        limit<std::size_t> (settings.fftDisplayBins_, 64, 1 << 16, defaults.fftDisplayBins_);
+        limit (settings.crossAlpha_, 0.001, 1., defaults.crossAlpha_);
+        limit<std::size_t> (settings.cqBinsPerOctave_, 0, 96, defaults.cqBinsPerOctave_);
+        limit (settings.cqMinFreq_, 1., 20000., defaults.cqMinFreq_);
+
+        store.beginGroup ("trigger");
+        read (store, "mode", triggerMode);
+        read (store, "level", settings.triggerLevel_);
+        read (store, "from", settings.triggerFrom_);
+        read (store, "to", settings.triggerTo_);
+        read (store, "bins", settings.triggerBins_);
+        read (store, "preRoll", settings.triggerPreRoll_);
+        read (store, "postRoll", settings.triggerPostRoll_);
+        read (store, "directory", settings.triggerDir_);
+        store.endGroup();
+        limit (triggerMode, static_cast<int> (TriggerMode::None), static_cast<int> (TriggerMode::Flux), static_cast<int> (defaults.triggerMode_));
+        limit (settings.triggerLevel_, 0., 10., defaults.triggerLevel_);
+        limit (settings.triggerFrom_, 0., 384000., defaults.triggerFrom_);
+        limit (settings.triggerTo_, 0., 384000., defaults.triggerTo_);
+        limit<std::size_t> (settings.triggerBins_, 1, 256, defaults.triggerBins_);
+        limit<std::size_t> (settings.triggerPreRoll_, 0, 256, defaults.triggerPreRoll_);
+        limit<std::size_t> (settings.triggerPostRoll_, 0, 256, defaults.triggerPostRoll_);
+        settings.triggerMode_ = static_cast<TriggerMode> (triggerMode);
+
+        store.beginGroup ("realtime");
+        read (store, "captureRtPriority", settings.captureRtPriority_);
+        read (store, "dftRtPriority", settings.dftRtPriority_);
+        read (store, "captureCpu", settings.captureCpu_);
+        read (store, "dftCpu", settings.dftCpu_);
+        read (store, "lockMemory", settings.lockMemory_);
+        store.endGroup();
+
+        store.beginGroup ("gui");
+        read (store, "maxFps", settings.maxFps_);
+        store.endGroup();
+        limit<std::size_t> (settings.maxFps_, 1, 240, defaults.maxFps_);
+    }
+
+    void saveSettings (const PCMSettings& settings, const QString& fileName)
+    {
+        std::unique_ptr<QSettings> spStore {openStore (fileName) };
+        QSettings& store = *spStore;
+
+        store.beginGroup ("capture");
+        write (store, "source", static_cast<int> (settings.source_));
+        write (store, "pcmName", settings.pcmName_);
+        write (store, "sourceFile", settings.sourceFile_);
+        write (store, "paced", settings.pacedSource_);
+        write (store, "rate", settings.rate_);
+        write (store, "channels", settings.channels_);
+        write (store, "periodSize", settings.periodSize_);
+        write (store, "periods", settings.periods_);
+        write (store, "xrunThreshold", settings.xrunThreshold_);
+        write (store, "xrunWindowMs", settings.xrunWindowMs_);
+        write (store, "maxPeriodSize", settings.maxPeriodSize_);
+        write (store, "maxPeriods", settings.maxPeriods_);
+        write (store, "poolBlocks", settings.poolBlocks_);
+        store.endGroup();
+
+        store.beginGroup ("generator");
+        write (store, "tones", joinTones (settings.genTones_));
+        write (store, "amplitude", settings.genAmplitude_);
+        write (store, "noise", settings.genNoise_);
+        write (store, "channelPhase", settings.genChannelPhase_);
+        write (store, "sweepFrom", settings.genSweepFrom_);
+        write (store, "sweepTo", settings.genSweepTo_);
+        write (store, "sweepSeconds", settings.genSweepSeconds_);
+        write (store, "seed", settings.genSeed_);
+        store.endGroup();
+
+        store.beginGroup ("transform");
+        write (store, "program", settings.clProgramName_);
+        write (store, "fftSize", settings.fftSize_);
+        write (store, "fftHop", settings.fftHop_);
+        write (store, "fftDisplayBins", settings.fftDisplayBins_);
+        write (store, "crossPairs", joinPairs (settings.crossPairs_));
+        write (store, "crossAlpha", settings.crossAlpha_);
+        write (store, "cqBinsPerOctave", settings.cqBinsPerOctave_);
+        write (store, "cqMinFreq", settings.cqMinFreq_);
+        store.endGroup();
+
+        store.beginGroup ("trigger");
+        write (store, "mode", static_cast<int> (settings.triggerMode_));
+        write (store, "level", settings.triggerLevel_);
+        write (store, "from", settings.triggerFrom_);
+        write (store, "to", settings.triggerTo_);
+        write (store, "bins", settings.triggerBins_);
+        write (store, "preRoll", settings.triggerPreRoll_);
+        write (store, "postRoll", settings.triggerPostRoll_);
+        write (store, "directory", settings.triggerDir_);
+        store.endGroup();
+
+        store.beginGroup ("realtime");
+        write (store, "captureRtPriority", settings.captureRtPriority_);
+        write (store, "dftRtPriority", settings.dftRtPriority_);
+        write (store, "captureCpu", settings.captureCpu_);
+        write (store, "dftCpu", settings.dftCpu_);
+        write (store, "lockMemory", settings.lockMemory_);
+        store.endGroup();
+
+        store.beginGroup ("gui");
+        write (store, "maxFps", settings.maxFps_);
+        store.endGroup();
+    }
+
+}
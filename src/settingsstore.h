@@ -0,0 +1,29 @@
+#ifndef SETTINGS_STORE_H
+#define SETTINGS_STORE_H
+#include <QString>
+
+#include "pcmsettings.h"
+
+namespace PCMDFT
+{
+
+    //Stages that have to be rebuilt for a settings change, combined as flags
+    enum SettingsChange
+    {
+        ChangeNone = 0,
+        ChangeGui = 1,          //repaint rate only
+        ChangeTransform = 2,    //re-plan the DFT thread, context and program are kept
+        ChangeCapture = 4,      //reopen the sample source on the running capture thread
+        ChangeRestart = 8,      //kernels, pools or memory locking, stop and start everything
+        ChangeTrigger = 16      //detection parameters, the trigger thread drops its pre-trigger ring
+    };
+
+    int settingsChanges (const PCMSettings& from, const PCMSettings& to);
+
+    //Read and write the settings as an ini file, an empty file name uses the per-user config file.
+    //Keys missing from the file keep their current value.
+    void loadSettings (PCMSettings& settings, const QString& fileName = QString {});
+    void saveSettings (const PCMSettings& settings, const QString& fileName = QString {});
+
+}
+#endif
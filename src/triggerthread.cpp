@@ -0,0 +1,312 @@
+#include "triggerthread.h"
+#include <QDateTime>
+#include <QDir>
+
+#include <algorithm>
+#include <cmath>
+
+#include "allocationcounter.h"
+#include "buffer.h"
+
+namespace PCMDFT
+{
+
+TriggerThread::TriggerThread (std::shared_ptr<const PCMSettings> spSettings, std::shared_ptr<BlockQueue> spInput,
+                              std::shared_ptr<BlockQueue> spOutput, QObject* parent) :
+    QObject {parent}, spThread_ {new QThread}, spSettings_ {spSettings}, spInput_ {spInput}, spOutput_ {spOutput},
+        spTSBuf_ {new TSBuffer {spSettings}},
+        preRollFirst_ {0}, preRollCount_ {0}, primed_ {false}, active_ {false}, quiet_ {0}, periods_ {0}, events_ {0},
+        allocations_ {0}
+{
+    plan();
+    inputNotifier_ = spInput_->connect (this, &TriggerThread::slotInputReady);
+    this->moveToThread (spThread_.get());
+    spThread_->start();
+}
+
+TriggerThread::~TriggerThread() = default;
+
+void TriggerThread::slotQuit()
+{
+    finishEvent();
+    dropPreRoll();
+    delete inputNotifier_;
+    inputNotifier_ = nullptr;
+    spThread_->quit();
+}
+
+void TriggerThread::waitForThread()
+{
+    spThread_->wait();
+}
+
+std::size_t TriggerThread::allocations() const
+{
+    return allocations_;
+}
+
+void TriggerThread::slotReconfigure (SettingsPtr spSettings)
+{
+    finishEvent();
+    dropPreRoll();
+    spSettings_ = spSettings;
+    spTSBuf_.reset (new TSBuffer {spSettings});
+    plan();
+    emit sigDebug ("Trigger reconfigured");
+}
+
+void TriggerThread::plan()
+{
+    //Bins at the centres of triggerBins_ equal slices of the band, clamped below Nyquist
+    const PCMSettings& settings = *spSettings_;
+    double nyquist {settings.rate_ / 2.},
+           from {std::min (settings.triggerFrom_, nyquist)},
+           to {std::min (settings.triggerTo_, nyquist)};
+    std::size_t bins {std::max<std::size_t> (settings.triggerBins_, 1)};
+    coeffs_.resize (bins);
+
+    for (std::size_t k = 0; k < bins; ++k)
+    {
+        double freq {from + (to - from) * (k + 0.5) / bins};
+        coeffs_[k] = 2. * std::cos (2. * M_PI * freq / settings.rate_);
+    }
+
+    magnitudes_.assign (bins, 0.);
+    previous_.assign (bins * settings.channels_, 0.);
+    primed_ = false;
+
+    //The ring is empty here, resizing it is the only allocation it ever makes
+    preRoll_.resize (settings.triggerPreRoll_);
+    preRollFirst_ = preRollCount_ = 0;
+}
+
+void TriggerThread::goertzel (const TSBuffer& buf, std::size_t chnl)
+{
+    std::size_t n {buf.size (chnl)};
+
+    for (std::size_t k = 0; k < coeffs_.size(); ++k)
+    {
+        double coeff {coeffs_[k]}, s1 {0.}, s2 {0.};
+
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            double s0 {buf.at (chnl, i) + coeff * s1 - s2};
+            s2 = s1;
+            s1 = s0;
+        }
+
+        //Amplitude of a sinusoid at the bin frequency
+        double power {std::max (s1 * s1 + s2 * s2 - coeff * s1 * s2, 0.)};
+        magnitudes_[k] = 2. * std::sqrt (power) / n;
+    }
+}
+
+double TriggerThread::detect (const TSBuffer& buf)
+{
+    double level {0.};
+
+    for (std::size_t chnl = 0; chnl < buf.size1(); ++chnl)
+    {
+        std::size_t n {buf.size (chnl)};
+        double value {0.};
+
+        switch (spSettings_->triggerMode_)
+        {
+            case TriggerMode::Rms:
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    value += buf.at (chnl, i) * buf.at (chnl, i);
+                }
+
+                value = std::sqrt (value / n);
+                break;
+
+            case TriggerMode::Peak:
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    value = std::max<double> (value, std::fabs (buf.at (chnl, i)));
+                }
+
+                break;
+
+            case TriggerMode::Band:
+                goertzel (buf, chnl);
+
+                for (double magnitude : magnitudes_)
+                {
+                    value += magnitude * magnitude;
+                }
+
+                value = std::sqrt (value);
+                break;
+
+            case TriggerMode::Flux:
+                {
+                    goertzel (buf, chnl);
+                    double* previous {previous_.data() + chnl * magnitudes_.size() };
+
+                    for (std::size_t k = 0; k < magnitudes_.size(); ++k)
+                    {
+                        value += std::max (magnitudes_[k] - previous[k], 0.);
+                        previous[k] = magnitudes_[k];
+                    }
+
+                    //The first period has nothing to compare against
+                    if (!primed_)
+                        value = 0.;
+
+                    break;
+                }
+
+            case TriggerMode::None:
+                break;
+        }
+
+        level = std::max (level, value);
+    }
+
+    primed_ = true;
+    return level;
+}
+
+void TriggerThread::startEvent (double level)
+{
+    active_ = true;
+    quiet_ = 0;
+    periods_ = 0;
+    ++events_;
+    emit sigEventStarted (events_, QDateTime::currentMSecsSinceEpoch(), level);
+
+    if (spSettings_->triggerDir_.empty())
+        return;
+
+    //Raw interleaved samples, the same format the file source reads
+    QDir dir {QString::fromStdString (spSettings_->triggerDir_)};
+    eventFileName_ = dir.filePath (QString {"event-%1.raw"}.arg (QDateTime::currentDateTime().toString ("yyyyMMdd-hhmmss-zzz")));
+    eventFile_.open (eventFileName_.toStdString(), std::ios::binary);
+
+    if (!eventFile_)
+    {
+        emit sigDebug (QString {"Cannot record event to %1"}.arg (eventFileName_));
+        eventFileName_.clear();
+    }
+}
+
+void TriggerThread::finishEvent()
+{
+    if (!active_)
+        return;
+
+    active_ = false;
+
+    if (eventFile_.is_open())
+        eventFile_.close();
+
+    emit sigEventFinished (events_, periods_, eventFileName_);
+    eventFileName_.clear();
+}
+
+void TriggerThread::forward (BlockPtr spTsBlock)
+{
+    ++periods_;
+
+    if (eventFile_.is_open())
+        eventFile_.write (spTsBlock->data(), spTsBlock->size());
+
+    spOutput_->push (std::move (spTsBlock));
+}
+
+void TriggerThread::keep (BlockPtr spTsBlock)
+{
+    if (preRoll_.empty())
+        return;
+
+    //A full ring overwrites its oldest slot, which hands that block back to the pool
+    preRoll_[ (preRollFirst_ + preRollCount_) % preRoll_.size()] = std::move (spTsBlock);
+
+    if (preRollCount_ < preRoll_.size())
+        ++preRollCount_;
+    else
+        preRollFirst_ = (preRollFirst_ + 1) % preRoll_.size();
+}
+
+void TriggerThread::dropPreRoll()
+{
+    for (BlockPtr& spBlock : preRoll_)
+    {
+        spBlock.reset();
+    }
+
+    preRollFirst_ = preRollCount_ = 0;
+}
+
+void TriggerThread::slotInputReady()
+{
+    AllocationScope allocationScope {allocations_};
+    spInput_->acknowledge();
+    BlockPtr spTsBlock;
+
+    while (spInput_->pop (spTsBlock))
+    {
+        process (std::move (spTsBlock));
+    }
+}
+
+void TriggerThread::process (BlockPtr spTsBlock)
+{
+    if (spSettings_->triggerMode_ == TriggerMode::None)
+    {
+        spOutput_->push (std::move (spTsBlock));
+        return;
+    }
+
+    //Periods captured before a channel count change are dropped
+    if (spTsBlock->channels() != spSettings_->channels_)
+        return;
+
+    TSBuffer& buf = *spTSBuf_;
+    buf.assign (spTsBlock->data(), spTsBlock->size());
+
+    if (!buf.size1() || !buf.size (0))
+        return;
+
+    double level {detect (buf)};
+    bool triggered {level >= spSettings_->triggerLevel_};
+
+    if (active_)
+    {
+        //Every triggering period extends the event by the post-trigger periods
+        forward (spTsBlock);
+        quiet_ = triggered ? 0 : quiet_ + 1;
+
+        if (quiet_ >= spSettings_->triggerPostRoll_)
+            finishEvent();
+
+        return;
+    }
+
+    if (!triggered)
+    {
+        //Keep the context of the next event
+        keep (std::move (spTsBlock));
+        return;
+    }
+
+    startEvent (level);
+
+    //The event does not continue the last period forwarded downstream
+    (preRollCount_ ? preRoll_[preRollFirst_] : spTsBlock)->setDiscontinuity (true);
+
+    for (std::size_t i = 0; i < preRollCount_; ++i)
+    {
+        forward (std::move (preRoll_[ (preRollFirst_ + i) % preRoll_.size()]));
+    }
+
+    preRollFirst_ = preRollCount_ = 0;
+    forward (spTsBlock);
+
+    if (!spSettings_->triggerPostRoll_)
+        finishEvent();
+}
+
+}
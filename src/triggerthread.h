@@ -0,0 +1,78 @@
+#ifndef TRIGGER_THREAD_H
+#define TRIGGER_THREAD_H
+#include <QObject>
+#include <QThread>
+#include <QString>
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include "bufferpool.h"
+#include "blockqueue.h"
+#include "pcmsettings.h"
+
+namespace PCMDFT
+{
+
+class TSBuffer;
+
+//Sits between the capture and the DFT thread and only forwards the periods around events, so the
+//transform, readback and plot stay idle while nothing happens. Periods are held back in a ring of
+//triggerPreRoll_ blocks, the capture pool has to be large enough to cover it.
+class TriggerThread : public QObject
+{
+    Q_OBJECT
+public:
+    TriggerThread (std::shared_ptr<const PCMSettings> spSettings, std::shared_ptr<BlockQueue> spInput,
+                   std::shared_ptr<BlockQueue> spOutput, QObject* parent = 0);
+    ~TriggerThread();
+
+    void waitForThread();
+    //Heap allocations made while processing periods, read from any thread
+    std::size_t allocations() const;
+
+public slots:
+    void slotQuit();
+    //Drains the input queue, called from the queue's notifier
+    void slotInputReady();
+    //Switch to new trigger settings, a running event is finished and the pre-trigger ring dropped
+    void slotReconfigure (SettingsPtr spSettings);
+
+signals:
+    void sigEventStarted (quint64 event, qint64 timestamp, double level);
+    void sigEventFinished (quint64 event, quint64 periods, QString fileName);
+    void sigDebug (QString value);
+
+private:
+    void process (BlockPtr spTsBlock);
+    void plan();
+    double detect (const TSBuffer& buf);
+    void goertzel (const TSBuffer& buf, std::size_t chnl);
+    void startEvent (double level);
+    void finishEvent();
+    void forward (BlockPtr spTsBlock);
+    void keep (BlockPtr spTsBlock);
+    void dropPreRoll();
+    std::unique_ptr<QThread> spThread_;
+    std::shared_ptr<const PCMSettings> spSettings_;
+    std::shared_ptr<BlockQueue> spInput_, spOutput_;
+    QSocketNotifier* inputNotifier_;
+    std::unique_ptr<TSBuffer> spTSBuf_;
+    //Pre-trigger ring of triggerPreRoll_ slots sized by plan(), preRollFirst_ is the oldest of preRollCount_ blocks
+    std::vector<BlockPtr> preRoll_;
+    std::size_t preRollFirst_, preRollCount_;
+    //Goertzel coefficients of the bank, magnitudes of the current and, per channel, the previous period
+    std::vector<double> coeffs_, magnitudes_, previous_;
+    bool primed_, active_;
+    std::size_t quiet_, periods_;
+    quint64 events_;
+    std::ofstream eventFile_;
+    QString eventFileName_;
+    std::atomic<std::size_t> allocations_;
+};
+
+}
+
+#endif